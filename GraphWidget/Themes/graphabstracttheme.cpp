@@ -2,3 +2,9 @@
 
 GraphAbstractTheme::GraphAbstractTheme() {}
 GraphAbstractTheme::~GraphAbstractTheme() {}
+
+QColor GraphAbstractTheme::seriesColor(const int series) const
+{
+    const QColor palette[] = {yellow, magenta, green, blue};
+    return palette[(series - 1) % 4];
+}
@@ -23,6 +23,8 @@ public:
     virtual int     graphMarkerSize()   const = 0;
     virtual QColor  graphLineColor()    const = 0;
     virtual int     graphLineThickness()const = 0;
+    // Colour of the additional series, series 0 uses the graph colours
+    virtual QColor  seriesColor(const int series) const;
 
 protected:
     const QColor transparent    = QColor(0, 0, 0, 0);
@@ -31,6 +33,10 @@ protected:
     const QColor red            = QColor(255, 0, 0);
     const QColor darkGreen      = QColor(80, 100, 80);
     const QColor teal           = QColor(85, 255, 255);
+    const QColor yellow         = QColor(255, 220, 0);
+    const QColor magenta        = QColor(255, 85, 255);
+    const QColor green          = QColor(0, 200, 0);
+    const QColor blue           = QColor(40, 120, 255);
 };
 
 #endif // GRAPHABSTRACTTHEME_H
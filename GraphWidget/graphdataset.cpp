@@ -1,50 +1,56 @@
 #include "graphdataset.h"
 #include <algorithm>
+#include <cmath>
 
 GraphDataSet::GraphDataSet()
-    : m_maxValue(0)
-    , m_minValue(0)
+    : m_maxQueue()
+    , m_minQueue()
+    , m_count(0)
     , m_data()
+    , m_head(0)
     , m_maxDataPoints(100)
 {
-
+    m_data.reserve(m_maxDataPoints);
 }
 
 void GraphDataSet::addData(double data)
 {
-    if (m_data.empty()) {
-        m_maxValue = data;
-        m_minValue = data;
-    }
-    else {
-        if (data > m_maxValue)
-            m_maxValue = data;
+    if (m_maxDataPoints == 0)
+        return;
 
-        if (data < m_minValue)
-            m_minValue = data;
+    if (m_data.size() < m_maxDataPoints) {
+        m_data.push_back(data);
     }
-
-    m_data.push_back(data);
-
-    if (m_data.size() > m_maxDataPoints) {
-        double removedValue = *m_data.begin();
-        m_data.erase(m_data.begin());
-
-        if (removedValue >= m_maxValue)
-            m_maxValue = *std::max_element(m_data.begin(), m_data.end());
-        else if (removedValue <= m_minValue)
-            m_minValue = *std::min_element(m_data.begin(), m_data.end());
+    else {
+        // Full: the oldest sample is overwritten in place
+        m_data[m_head] = data;
+        m_head = (m_head + 1) % m_data.size();
     }
+    pushExtremes(data);
 }
 
 std::vector<double> GraphDataSet::data() const
 {
-    return m_data;
+    auto spans = this->spans();
+    std::vector<double> data(spans.first.begin(), spans.first.end());
+    data.insert(data.end(), spans.second.begin(), spans.second.end());
+    return data;
+}
+
+std::pair<GraphDataSet::Span, GraphDataSet::Span> GraphDataSet::spans() const
+{
+    const double* base = m_data.data();
+    Span first = {base + m_head, m_data.size() - m_head};
+    Span second = {base, m_head};
+    return std::make_pair(first, second);
 }
 
 std::pair<double, double> GraphDataSet::range() const
 {
-    return std::make_pair(m_minValue, m_maxValue);
+    if (m_minQueue.empty())
+        return std::make_pair(0.0, 0.0);
+
+    return std::make_pair(m_minQueue.front().second, m_maxQueue.front().second);
 }
 
 int GraphDataSet::size() const
@@ -52,27 +58,80 @@ int GraphDataSet::size() const
     return static_cast<int>(m_data.size());
 }
 
+int GraphDataSet::maxSize() const
+{
+    return static_cast<int>(m_maxDataPoints);
+}
+
 void GraphDataSet::setMaxSize(const int maxSize)
 {
-    m_maxDataPoints = static_cast<std::size_t>(maxSize);
+    m_maxDataPoints = static_cast<std::size_t>(std::max(maxSize, 0));
 
+    linearize();
     int excessData = static_cast<int>(m_data.size()) - maxSize;
 
     if (excessData > 0) {
-        for (int i = 0; i < excessData; i++) {
-            m_data.pop_back();
-        }
-
-        m_maxValue = *std::max_element(m_data.begin(), m_data.end());
-        m_minValue = *std::min_element(m_data.begin(), m_data.end());
+        // The newest samples are kept
+        m_data.erase(m_data.begin(), m_data.begin() + excessData);
+        rebuildExtremes();
     }
+    m_data.reserve(m_maxDataPoints);
 }
 
 double GraphDataSet::operator[](int id) const
 {
     std::size_t idVect = static_cast<std::size_t>(id);
     if (idVect < m_data.size())
-        return m_data[idVect];
+        return m_data[(m_head + idVect) % m_data.size()];
     else
         return 0;
 }
+
+void GraphDataSet::linearize()
+{
+    std::rotate(m_data.begin(), m_data.begin() + static_cast<std::ptrdiff_t>(m_head), m_data.end());
+    m_head = 0;
+}
+
+void GraphDataSet::pushExtremes(const double data)
+{
+    // Each sample enters and leaves each queue once, amortized O(1) per sample
+    const unsigned long long number = m_count++;
+    const unsigned long long oldest = m_count - m_data.size();
+    if (std::isnan(data)) {
+        // A skipped sample holds its place in the window but never an extreme
+        while (!m_maxQueue.empty() && m_maxQueue.front().first < oldest)
+            m_maxQueue.pop_front();
+        while (!m_minQueue.empty() && m_minQueue.front().first < oldest)
+            m_minQueue.pop_front();
+        return;
+    }
+
+    while (!m_maxQueue.empty() && m_maxQueue.back().second <= data)
+        m_maxQueue.pop_back();
+    m_maxQueue.emplace_back(number, data);
+
+    while (!m_minQueue.empty() && m_minQueue.back().second >= data)
+        m_minQueue.pop_back();
+    m_minQueue.emplace_back(number, data);
+
+    while (m_maxQueue.front().first < oldest)
+        m_maxQueue.pop_front();
+    while (m_minQueue.front().first < oldest)
+        m_minQueue.pop_front();
+}
+
+void GraphDataSet::rebuildExtremes()
+{
+    m_maxQueue.clear();
+    m_minQueue.clear();
+    m_count = 0;
+
+    std::vector<double> window;
+    window.swap(m_data);
+    m_head = 0;
+    for (auto value : window) {
+        m_data.push_back(value);
+        pushExtremes(value);
+    }
+}
@@ -2,25 +2,48 @@
 #define GRAPHDATASET_H
 
 #include <vector>
+#include <deque>
+#include <utility>
+#include <cstddef>
 
 class GraphDataSet
 {
 public:
+    // Contiguous run of samples, oldest first
+    struct Span {
+        const double* data;
+        std::size_t size;
+
+        const double* begin() const { return data; }
+        const double* end() const { return data + size; }
+    };
+
     GraphDataSet();
 
+    // NaN marks a skipped sample: it keeps its slot but is left out of range()
     void addData(const double data);
     std::vector<double> data() const;
+    // The buffer wraps at most once: first then second hold every sample in order, without copies
+    std::pair<Span, Span> spans() const;
     std::pair<double, double> range() const;
     int size() const;
+    int maxSize() const;
     void setMaxSize(const int maxSize);
 
     double operator[](int id) const;
 
 private:
-    double m_maxValue;
-    double m_minValue;
+    void linearize();
+    void pushExtremes(const double data);
+    void rebuildExtremes();
+
+    // Monotonic queues of (sample number, value): the front is the extreme of the window
+    std::deque<std::pair<unsigned long long, double>> m_maxQueue;
+    std::deque<std::pair<unsigned long long, double>> m_minQueue;
+    unsigned long long m_count;     // Samples added since the window was last rebuilt
 
-    std::vector<double> m_data;
+    std::vector<double> m_data;     // Circular once full, m_head is the oldest sample
+    std::size_t m_head;
     std::size_t m_maxDataPoints;
 
 };
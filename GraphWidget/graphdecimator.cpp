@@ -0,0 +1,103 @@
+#include "graphdecimator.h"
+#include <algorithm>
+#include <cmath>
+
+GraphDecimator::GraphDecimator()
+    : m_buckets()
+    , m_capacity(100)
+    , m_bucketSize(1)
+    , m_count(0)
+{
+
+}
+
+void GraphDecimator::setLayout(const std::size_t capacity, const int columns)
+{
+    m_capacity = capacity;
+    // About two points per column: each bucket contributes its minimum and maximum
+    const std::size_t perColumn = (capacity + static_cast<std::size_t>(std::max(columns, 1)) - 1)
+                                  / static_cast<std::size_t>(std::max(columns, 1));
+    m_bucketSize = static_cast<int>(std::max<std::size_t>(perColumn, 1));
+    clear();
+}
+
+void GraphDecimator::clear()
+{
+    m_buckets.clear();
+    m_count = 0;
+}
+
+void GraphDecimator::addData(const double x, const double y)
+{
+    const unsigned long long number = m_count++;
+
+    if (m_buckets.empty() || m_buckets.back().samples >= m_bucketSize) {
+        m_buckets.push_back({number, 1, x, y, x, y, true});
+    }
+    else {
+        Bucket& bucket = m_buckets.back();
+        bucket.last = number;
+        bucket.samples++;
+        if (std::isnan(bucket.minY)) {
+            // Only skipped samples so far
+            bucket.minX = bucket.maxX = x;
+            bucket.minY = bucket.maxY = y;
+        }
+        if (y < bucket.minY) {
+            bucket.minX = x;
+            bucket.minY = y;
+            bucket.minFirst = false;
+        }
+        if (y > bucket.maxY) {
+            bucket.maxX = x;
+            bucket.maxY = y;
+            bucket.minFirst = true;
+        }
+    }
+
+    // Buckets whose samples have all left the window are dropped
+    if (m_count > m_capacity) {
+        const unsigned long long oldest = m_count - m_capacity;
+        while (!m_buckets.empty() && m_buckets.front().last < oldest)
+            m_buckets.pop_front();
+    }
+}
+
+const std::deque<GraphDecimator::Bucket>& GraphDecimator::buckets() const
+{
+    return m_buckets;
+}
+
+GraphDecimator::Bucket GraphDecimator::front(const GraphDataSet& xData, const GraphDataSet& yData) const
+{
+    const Bucket& bucket = m_buckets.front();
+    const unsigned long long oldest = (m_count > m_capacity) ? m_count - m_capacity : 0;
+    if (bucket.last + 1 - static_cast<unsigned long long>(bucket.samples) >= oldest)
+        return bucket;
+
+    // Partly evicted: its extremes may belong to samples outside the window and the data ranges
+    const int kept = static_cast<int>(bucket.last + 1 - oldest);
+    Bucket refit = {bucket.last, kept, xData[0], yData[0], xData[0], yData[0], true};
+    for (int i = 1; i < kept; i++) {
+        if (std::isnan(refit.minY)) {
+            refit.minX = refit.maxX = xData[i];
+            refit.minY = refit.maxY = yData[i];
+        }
+        if (yData[i] < refit.minY) {
+            refit.minX = xData[i];
+            refit.minY = yData[i];
+            refit.minFirst = false;
+        }
+        if (yData[i] > refit.maxY) {
+            refit.maxX = xData[i];
+            refit.maxY = yData[i];
+            refit.minFirst = true;
+        }
+    }
+    return refit;
+}
+
+int GraphDecimator::bucketSize() const
+{
+    return m_bucketSize;
+}
@@ -0,0 +1,44 @@
+#ifndef GRAPHDECIMATOR_H
+#define GRAPHDECIMATOR_H
+
+#include <deque>
+#include <cstddef>
+#include "graphdataset.h"
+
+// Min/max decimation of a sliding sample window: every bucket of consecutive samples keeps
+// its lowest and highest point, so spikes survive however many samples share a pixel column
+class GraphDecimator
+{
+public:
+    struct Bucket {
+        unsigned long long last;    // Number of the newest sample in the bucket
+        int samples;
+        double minX;
+        double minY;
+        double maxX;
+        double maxY;
+        bool minFirst;              // The minimum was sampled before the maximum
+    };                              // minY and maxY are NaN while every sample was skipped
+
+    GraphDecimator();
+
+    // Window capacity in samples and the number of pixel columns it is drawn on
+    void setLayout(const std::size_t capacity, const int columns);
+    void clear();
+    void addData(const double x, const double y);
+
+    // Oldest first, two points per bucket
+    const std::deque<Bucket>& buckets() const;
+    // The oldest bucket refitted to the samples still in the window, drawn instead of buckets().front()
+    Bucket front(const GraphDataSet& xData, const GraphDataSet& yData) const;
+    int bucketSize() const;
+
+private:
+    std::deque<Bucket> m_buckets;
+    std::size_t m_capacity;
+    int m_bucketSize;
+    unsigned long long m_count;
+
+};
+
+#endif // GRAPHDECIMATOR_H
@@ -0,0 +1,50 @@
+#include "graphframeclock.h"
+#include <algorithm>
+
+GraphFrameClock& GraphFrameClock::instance()
+{
+    static GraphFrameClock clock;
+    return clock;
+}
+
+GraphFrameClock::GraphFrameClock()
+    : QObject(nullptr)
+    , m_interval(1000 / DEFAULT_FRAME_RATE)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &GraphFrameClock::frame);
+    m_sinceFrame.start();
+}
+
+void GraphFrameClock::setMaxFrameRate(const int rate)
+{
+    // Above 1000 frames per second the interval would round down to zero
+    m_interval = 1000 / std::min(std::max(rate, 1), 1000);
+}
+
+int GraphFrameClock::maxFrameRate() const
+{
+    return 1000 / m_interval;
+}
+
+void GraphFrameClock::request(QWidget* widget)
+{
+    if (std::find(m_dirty.begin(), m_dirty.end(), widget) == m_dirty.end())
+        m_dirty.emplace_back(widget);
+
+    // The first request after a quiet spell is drawn right away, later ones wait for the next frame
+    if (!m_timer.isActive())
+        m_timer.start(std::max(0, m_interval - static_cast<int>(m_sinceFrame.elapsed())));
+}
+
+void GraphFrameClock::frame()
+{
+    m_sinceFrame.restart();
+    for (auto& widget : m_dirty)
+    {
+        if (widget && widget->isVisible() && !widget->window()->isMinimized())
+            widget->update();
+    }
+    m_dirty.clear();
+}
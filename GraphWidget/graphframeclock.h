@@ -0,0 +1,36 @@
+#ifndef GRAPHFRAMECLOCK_H
+#define GRAPHFRAMECLOCK_H
+
+#include <QObject>
+#include <QWidget>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <vector>
+
+// Collects repaint requests from every GraphWidget and repaints them together, at most maxFrameRate times a second
+class GraphFrameClock : public QObject
+{
+    Q_OBJECT
+public:
+    static GraphFrameClock& instance();
+
+    void setMaxFrameRate(const int rate);
+    int maxFrameRate() const;
+    // Repaints the widget with the next frame; hidden widgets are skipped, showing them repaints anyway
+    void request(QWidget* widget);
+
+private:
+    GraphFrameClock();
+    void frame();
+
+private:
+    std::vector<QPointer<QWidget>> m_dirty;
+    QTimer m_timer;
+    QElapsedTimer m_sinceFrame;
+    int m_interval;                         // [Milliseconds]
+
+    const int DEFAULT_FRAME_RATE = 30;      // [Hz]
+};
+
+#endif // GRAPHFRAMECLOCK_H
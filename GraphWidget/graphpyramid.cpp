@@ -0,0 +1,110 @@
+#include "graphpyramid.h"
+#include <algorithm>
+
+GraphPyramid::GraphPyramid()
+    : m_levels(1)
+    , m_maxSize(1 << 16)
+{
+
+}
+
+void GraphPyramid::setMaxSize(const std::size_t maxSize)
+{
+    m_maxSize = std::max<std::size_t>(maxSize, 2);
+    if (m_levels.front().size() >= m_maxSize)
+        compact();
+}
+
+std::size_t GraphPyramid::maxSize() const
+{
+    return m_maxSize;
+}
+
+void GraphPyramid::clear()
+{
+    m_levels.assign(1, std::vector<Node>());
+}
+
+void GraphPyramid::addData(const double x, const double y)
+{
+    m_levels.front().push_back({x, x, y, y});
+    const std::size_t number = m_levels.front().size() - 1;
+
+    // The new sample extends the last node of every coarser level, O(log n) per sample
+    for (std::size_t level = 1; (number >> level) > 0 || level < m_levels.size(); level++) {
+        if (level == m_levels.size()) {
+            // A new top level starts with the two nodes below it that are already complete
+            const std::vector<Node>& below = m_levels[level - 1];
+            m_levels.push_back({{below[0].firstX, below[1].lastX,
+                                 std::min(below[0].minY, below[1].minY),
+                                 std::max(below[0].maxY, below[1].maxY)}});
+        }
+
+        std::vector<Node>& nodes = m_levels[level];
+        const std::size_t index = number >> level;
+        if (index == nodes.size()) {
+            nodes.push_back({x, x, y, y});
+        }
+        else {
+            Node& node = nodes.back();
+            node.lastX = x;
+            node.minY = std::min(node.minY, y);
+            node.maxY = std::max(node.maxY, y);
+        }
+    }
+
+    if (m_levels.front().size() >= m_maxSize)
+        compact();
+}
+
+int GraphPyramid::size() const
+{
+    return static_cast<int>(m_levels.front().size());
+}
+
+std::pair<double, double> GraphPyramid::xRange() const
+{
+    const std::vector<Node>& samples = m_levels.front();
+    if (samples.empty())
+        return std::make_pair(0.0, 0.0);
+
+    return std::make_pair(samples.front().firstX, samples.back().lastX);
+}
+
+void GraphPyramid::view(const double from, const double to, const int columns, std::vector<Node>& nodes) const
+{
+    nodes.clear();
+    const std::vector<Node>& samples = m_levels.front();
+
+    // x grows with the sample number, so the range is found by bisection
+    auto first = std::lower_bound(samples.begin(), samples.end(), from, [](const Node& node, double x) {
+        return node.lastX < x;
+    });
+    auto last = std::upper_bound(first, samples.end(), to, [](double x, const Node& node) {
+        return x < node.firstX;
+    });
+    if (first == last)
+        return;
+
+    const std::size_t begin = static_cast<std::size_t>(first - samples.begin());
+    const std::size_t end = static_cast<std::size_t>(last - samples.begin());
+
+    std::size_t level = 0;
+    while (level + 1 < m_levels.size() && ((end - begin) >> level) > static_cast<std::size_t>(std::max(columns, 1)))
+        level++;
+
+    const std::vector<Node>& buckets = m_levels[level];
+    const std::size_t lastBucket = std::min((end - 1) >> level, buckets.size() - 1);
+    nodes.assign(buckets.begin() + static_cast<std::ptrdiff_t>(begin >> level),
+                 buckets.begin() + static_cast<std::ptrdiff_t>(lastBucket + 1));
+}
+
+void GraphPyramid::compact()
+{
+    // Amortized O(1): the newest half is re-added once every maxSize / 2 samples
+    std::vector<Node> samples;
+    samples.swap(m_levels.front());
+    clear();
+    for (std::size_t i = samples.size() / 2; i < samples.size(); i++)
+        addData(samples[i].firstX, samples[i].minY);
+}
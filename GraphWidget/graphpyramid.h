@@ -0,0 +1,41 @@
+#ifndef GRAPHPYRAMID_H
+#define GRAPHPYRAMID_H
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+// Sample history with min/max levels at 2x downsampling, built as samples arrive.
+// Any x range is read from the level that holds about as many buckets as there are pixel columns.
+class GraphPyramid
+{
+public:
+    struct Node {
+        double firstX;
+        double lastX;
+        double minY;
+        double maxY;
+    };
+
+    GraphPyramid();
+
+    // Once the history holds this many samples the older half is dropped
+    void setMaxSize(const std::size_t maxSize);
+    std::size_t maxSize() const;
+    void clear();
+    void addData(const double x, const double y);
+
+    int size() const;
+    std::pair<double, double> xRange() const;
+    // Buckets covering [from, to], at most about columns of them, oldest first
+    void view(const double from, const double to, const int columns, std::vector<Node>& nodes) const;
+
+private:
+    void compact();
+
+    std::vector<std::vector<Node>> m_levels;    // Level k node i covers samples [i * 2^k, (i + 1) * 2^k)
+    std::size_t m_maxSize;
+
+};
+
+#endif // GRAPHPYRAMID_H
@@ -0,0 +1,57 @@
+#include "graphrenderer.h"
+#include <QPainter>
+
+GraphRenderer& GraphRenderer::instance()
+{
+    static GraphRenderer renderer;
+    return renderer;
+}
+
+GraphRenderer::GraphRenderer()
+    : QObject(nullptr)
+{
+    qRegisterMetaType<GraphRenderer::Frame>();
+    qRegisterMetaType<GraphRenderer::Ranges>();
+    m_thread.setObjectName("GraphRenderer");
+    moveToThread(&m_thread);
+    m_thread.start(QThread::LowPriority);
+}
+
+GraphRenderer::~GraphRenderer()
+{
+    stop();
+}
+
+void GraphRenderer::submit(const quint64 owner, const quint64 serial, const GraphRenderer::Frame& frame)
+{
+    QMetaObject::invokeMethod(this, "render", Qt::QueuedConnection,
+                              Q_ARG(quint64, owner),
+                              Q_ARG(quint64, serial),
+                              Q_ARG(GraphRenderer::Frame, frame));
+}
+
+void GraphRenderer::stop()
+{
+    m_thread.quit();
+    m_thread.wait();
+}
+
+void GraphRenderer::render(const quint64 owner, const quint64 serial, const GraphRenderer::Frame& frame)
+{
+    QImage image(frame.size * frame.ratio, QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(frame.ratio);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+    for (const auto& layer : frame.layers) {
+        painter.setPen(layer.marker);
+        painter.drawPoints(layer.points);
+
+        painter.setPen(layer.line);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.drawPolyline(layer.points);
+    }
+    painter.end();
+
+    emit rendered(owner, serial, image, frame.ranges);
+}
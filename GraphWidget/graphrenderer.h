@@ -0,0 +1,57 @@
+#ifndef GRAPHRENDERER_H
+#define GRAPHRENDERER_H
+
+#include <QObject>
+#include <QThread>
+#include <QImage>
+#include <QPolygonF>
+#include <QPen>
+#include <QSize>
+#include <vector>
+#include <utility>
+
+// Rasterizes the data layer of GraphWidgets on one worker thread shared by every widget
+class GraphRenderer : public QObject
+{
+    Q_OBJECT
+public:
+    struct Layer {
+        QPolygonF points;
+        QPen marker;
+        QPen line;
+    };
+    // The data ranges the layers were mapped with, so labels can match the finished image
+    struct Ranges {
+        std::pair<double, double> x;
+        std::vector<std::pair<double, double>> y;
+    };
+    // Everything a frame needs, copied so the GUI thread can keep changing the widget
+    struct Frame {
+        QSize size;
+        qreal ratio;
+        std::vector<Layer> layers;
+        Ranges ranges;
+    };
+
+    static GraphRenderer& instance();
+    ~GraphRenderer();
+    // The result comes back through rendered() with the same owner and serial
+    void submit(const quint64 owner, const quint64 serial, const Frame& frame);
+    void stop();
+
+signals:
+    void rendered(const quint64 owner, const quint64 serial, const QImage& image, const GraphRenderer::Ranges& ranges);
+
+private slots:
+    void render(const quint64 owner, const quint64 serial, const GraphRenderer::Frame& frame);
+
+private:
+    GraphRenderer();
+
+    QThread m_thread;
+};
+
+Q_DECLARE_METATYPE(GraphRenderer::Frame)
+Q_DECLARE_METATYPE(GraphRenderer::Ranges)
+
+#endif // GRAPHRENDERER_H
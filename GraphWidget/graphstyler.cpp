@@ -70,19 +70,29 @@ void GraphStyler::labelStyle(QPainter& painter) const
     painter.setFont(font);
 }
 
-void GraphStyler::graphMarkerStyle(QPainter& painter) const
+void GraphStyler::graphMarkerStyle(QPainter& painter, const int series) const
+{
+    painter.setPen(graphMarkerPen(series));
+}
+
+void GraphStyler::graphLineStyle(QPainter& painter, const int series) const
+{
+    painter.setPen(graphLinePen(series));
+    painter.setRenderHint(QPainter::Antialiasing);
+}
+
+QPen GraphStyler::graphMarkerPen(const int series) const
 {
     QPen pen;
-    pen.setColor(m_theme->graphMarkerColor());
+    pen.setColor(series == 0 ? m_theme->graphMarkerColor() : m_theme->seriesColor(series));
     pen.setWidth(m_theme->graphMarkerSize());
-    painter.setPen(pen);
+    return pen;
 }
 
-void GraphStyler::graphLineStyle(QPainter& painter) const
+QPen GraphStyler::graphLinePen(const int series) const
 {
     QPen pen;
-    pen.setColor(m_theme->graphLineColor());
+    pen.setColor(series == 0 ? m_theme->graphLineColor() : m_theme->seriesColor(series));
     pen.setWidth(m_theme->graphLineThickness());
-    painter.setPen(pen);
-    painter.setRenderHint(QPainter::Antialiasing);
+    return pen;
 }
@@ -24,8 +24,11 @@ public:
     void borderStyle(QPainter& painter) const;
     void axisStyle(QPainter& painter) const;
     void labelStyle(QPainter& painter) const;
-    void graphMarkerStyle(QPainter& painter) const;
-    void graphLineStyle(QPainter& painter) const;
+    void graphMarkerStyle(QPainter& painter, const int series = 0) const;
+    void graphLineStyle(QPainter& painter, const int series = 0) const;
+    // The graph pens alone, for painting away from the GUI thread
+    QPen graphMarkerPen(const int series = 0) const;
+    QPen graphLinePen(const int series = 0) const;
 
 private:
     GraphAbstractTheme* m_theme;
@@ -1,5 +1,11 @@
 #include "graphwidget.h"
 #include <QPainter>
+#include <QWheelEvent>
+#include <QMouseEvent>
+#include "graphframeclock.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 #include <QtDebug>
 
@@ -12,51 +18,154 @@ GraphWidget::GraphWidget(int width, int height, QWidget* parent)
     , m_xAxis(width, 20)
     , m_yAxis(height, 10)
     , m_xDataSet()
-    , m_yDataSet()
+    , m_series(1)
     , m_ticksMatchData(false)
     , m_xLabelSkip(2)
     , m_yLabelSkip(2)
+    , m_live(true)
+    , m_viewSpan(0)
+    , m_viewEnd(0)
+    , m_dragging(false)
+    , m_dragStartX(0)
+    , m_dragStartEnd(0)
+    , m_threaded(false)
+    , m_dataDirty(true)
+    , m_frameBusy(false)
+    , m_frameSerial(0)
+    , m_staticLayerValid(false)
 {
     setBackgroundRole(QPalette::Base);
     setAutoFillBackground(false);
+    rebuildDecimation(m_series.front());
+}
+
+int GraphWidget::addSeries(const QString& name)
+{
+    m_series.emplace_back();
+    Series& series = m_series.back();
+    series.name = name;
+    series.data.setMaxSize(m_xDataSet.maxSize());
+    series.history.setMaxSize(m_series.front().history.maxSize());
+
+    // Samples taken before the series existed are skipped, keeping the x samples aligned
+    for (int i = 0; i < m_xDataSet.size(); i++)
+        series.data.addData(std::numeric_limits<double>::quiet_NaN());
+    rebuildDecimation(series);
+    m_dataDirty = true;
+    GraphFrameClock::instance().request(this);
+    return static_cast<int>(m_series.size()) - 1;
+}
+
+int GraphWidget::seriesCount() const
+{
+    return static_cast<int>(m_series.size());
+}
+
+void GraphWidget::setSeriesName(const int index, const QString& name)
+{
+    if (index < 0 || index >= seriesCount())
+        return;
+
+    m_series[static_cast<std::size_t>(index)].name = name;
+    GraphFrameClock::instance().request(this);
 }
 
 void GraphWidget::addData(double xData, double yData)
+{
+    addData(xData, std::vector<double>(1, yData));
+}
+
+void GraphWidget::addData(double xData, const std::vector<double>& yData)
 {
     m_xDataSet.addData(xData);
-    m_yDataSet.addData(yData);
-    update();
+    for (std::size_t i = 0; i < m_series.size(); i++) {
+        double yValue = (i < yData.size()) ? yData[i] : std::numeric_limits<double>::quiet_NaN();
+        m_series[i].data.addData(yValue);
+        m_series[i].decimator.addData(xData, yValue);
+        if (!std::isnan(yValue))
+            m_series[i].history.addData(xData, yValue);
+    }
+    matchTicksToData();
+    m_dataDirty = true;
+    GraphFrameClock::instance().request(this);
 }
 
 void GraphWidget::setSampleBufferSize(const int size)
 {
     m_xDataSet.setMaxSize(size);
-    m_yDataSet.setMaxSize(size);
-    update();
+    for (auto& series : m_series) {
+        series.data.setMaxSize(size);
+        rebuildDecimation(series);
+    }
+    matchTicksToData();
+    m_dataDirty = true;
+    GraphFrameClock::instance().request(this);
+}
+
+void GraphWidget::setHistorySize(const int size)
+{
+    for (auto& series : m_series)
+        series.history.setMaxSize(static_cast<std::size_t>(std::max(size, 2)));
+    m_dataDirty = true;
+    GraphFrameClock::instance().request(this);
+}
+
+void GraphWidget::setThreadedRendering(const bool threaded)
+{
+    if (threaded && !m_threaded) {
+        connect(&GraphRenderer::instance(), &GraphRenderer::rendered, this,
+                [=](const quint64 owner, const quint64 serial, const QImage& image, const GraphRenderer::Ranges& ranges) {
+            if (owner != reinterpret_cast<quintptr>(this) || serial != m_frameSerial)
+                return;
+
+            m_dataLayer = image;
+            m_dataLayerRanges = ranges;
+            m_frameBusy = false;
+            if (m_dataDirty)
+                requestFrame();
+            update();
+        });
+    }
+    else if (!threaded && m_threaded) {
+        disconnect(&GraphRenderer::instance(), &GraphRenderer::rendered, this, nullptr);
+        m_frameBusy = false;
+        m_dataLayer = QImage();
+    }
+    m_threaded = threaded;
+    m_dataDirty = true;
+    GraphFrameClock::instance().request(this);
 }
 
 void GraphWidget::setTheme(const GraphStyler::GraphThemeSelection theme)
 {
     m_style.setTheme(theme);
-    update();
+    invalidateStaticLayer();
+    m_dataDirty = true;
+    GraphFrameClock::instance().request(this);
 }
 
 void GraphWidget::setXTicks(const int ticks)
 {
     m_xAxis.setTicks(ticks);
-    update();
+    invalidateStaticLayer();
+    m_dataDirty = true;
+    GraphFrameClock::instance().request(this);
 }
 
 void GraphWidget::setYTicks(const int ticks)
 {
     m_yAxis.setTicks(ticks);
-    update();
+    invalidateStaticLayer();
+    m_dataDirty = true;
+    GraphFrameClock::instance().request(this);
 }
 
 void GraphWidget::setTicksToMatchData(const bool match)
 {
     m_ticksMatchData = match;
-    update();
+    matchTicksToData();
+    m_dataDirty = true;
+    GraphFrameClock::instance().request(this);
 }
 
 QSize GraphWidget::minimumSizeHint() const
@@ -71,18 +180,181 @@ QSize GraphWidget::sizeHint() const
 
 void GraphWidget::paintEvent(QPaintEvent* /*event*/)
 {
+    updateFrameRanges();
+    if (!m_staticLayerValid)
+        renderStaticLayer();
 
     QPainter painter(this);
 
+    painter.drawPixmap(0, 0, m_staticLayer);
+    // The labels follow the data ranges, which move with every live sample, so they stay out of the cache
+    if (!m_threaded) {
+        drawXLabels(painter, m_frameXRange);
+        drawYLabels(painter, m_frameYRanges.front());
+        drawLegend(painter, m_frameYRanges);
+        drawGraph(painter);
+        m_dataDirty = false;
+        return;
+    }
+
+    // While a frame is on the render thread further changes wait for it, see setThreadedRendering()
+    if (m_dataDirty && !m_frameBusy)
+        requestFrame();
+
+    if (m_dataLayer.isNull())
+        return;
+
+    // The labels describe the image on screen, not the data that has arrived since
+    drawXLabels(painter, m_dataLayerRanges.x);
+    drawYLabels(painter, m_dataLayerRanges.y.front());
+    drawLegend(painter, m_dataLayerRanges.y);
+    painter.drawImage(0, 0, m_dataLayer);
+}
+
+void GraphWidget::resizeEvent(QResizeEvent* event)
+{
+    invalidateStaticLayer();
+    m_dataDirty = true;
+    QWidget::resizeEvent(event);
+}
+
+void GraphWidget::wheelEvent(QWheelEvent* event)
+{
+    leaveLive();
+    m_viewSpan *= (event->angleDelta().y() > 0) ? 0.5 : 2.0;
+    clampView();
+    m_dataDirty = true;
+    update();
+    event->accept();
+}
+
+void GraphWidget::mousePressEvent(QMouseEvent* event)
+{
+    if (event->button() != Qt::LeftButton)
+        return QWidget::mousePressEvent(event);
+
+    leaveLive();
+    m_dragging = true;
+    m_dragStartX = event->pos().x();
+    m_dragStartEnd = m_viewEnd;
+}
+
+void GraphWidget::mouseMoveEvent(QMouseEvent* event)
+{
+    if (!m_dragging)
+        return QWidget::mouseMoveEvent(event);
+
+    const double unitsPerPixel = m_viewSpan / std::max(m_xAxis.getLength(), 1);
+    m_viewEnd = m_dragStartEnd - (event->pos().x() - m_dragStartX) * unitsPerPixel;
+    clampView();
+    m_dataDirty = true;
+    update();
+}
+
+void GraphWidget::mouseReleaseEvent(QMouseEvent* event)
+{
+    m_dragging = false;
+    QWidget::mouseReleaseEvent(event);
+}
+
+void GraphWidget::mouseDoubleClickEvent(QMouseEvent* /*event*/)
+{
+    m_live = true;
+    m_dragging = false;
+    m_dataDirty = true;
+    update();
+}
+
+void GraphWidget::invalidateStaticLayer()
+{
+    m_staticLayerValid = false;
+}
+
+void GraphWidget::updateFrameRanges()
+{
+    m_frameYRanges.resize(m_series.size());
+    if (m_live) {
+        m_frameXRange = m_xDataSet.range();
+        for (std::size_t i = 0; i < m_series.size(); i++)
+            m_frameYRanges[i] = m_series[i].data.range();
+        return;
+    }
+
+    // About one pyramid bucket per pixel column, whatever the zoom
+    const double from = m_viewEnd - m_viewSpan;
+    m_frameXRange = std::make_pair(from, m_viewEnd);
+    for (std::size_t i = 0; i < m_series.size(); i++) {
+        Series& series = m_series[i];
+        series.history.view(from, m_viewEnd, m_xAxis.getLength(), series.view);
+
+        std::pair<double, double> range(0, 0);
+        if (!series.view.empty()) {
+            range = std::make_pair(series.view.front().minY, series.view.front().maxY);
+            for (const auto& node : series.view) {
+                range.first = std::min(range.first, node.minY);
+                range.second = std::max(range.second, node.maxY);
+            }
+        }
+        m_frameYRanges[i] = range;
+    }
+}
+
+void GraphWidget::leaveLive()
+{
+    if (!m_live)
+        return;
+
+    const std::pair<double, double> range = m_xDataSet.range();
+    m_viewEnd = range.second;
+    m_viewSpan = range.second - range.first;
+    m_live = false;
+    clampView();
+}
+
+void GraphWidget::clampView()
+{
+    const std::pair<double, double> history = m_series.front().history.xRange();
+    const double length = history.second - history.first;
+
+    m_viewSpan = std::max(m_viewSpan, MIN_VIEW_SPAN);
+    if (length > 0)
+        m_viewSpan = std::min(m_viewSpan, length);
+    m_viewEnd = std::min(std::max(m_viewEnd, history.first + m_viewSpan), history.second);
+}
+
+void GraphWidget::matchTicksToData()
+{
+    if (m_ticksMatchData && m_xAxis.getTicks() != m_xDataSet.size()) {
+        m_xAxis.setTicks(m_xDataSet.size());
+        invalidateStaticLayer();
+    }
+}
+
+void GraphWidget::rebuildDecimation(Series& series)
+{
+    series.decimator.setLayout(static_cast<std::size_t>(series.data.maxSize()), m_xAxis.getLength());
+
+    const int count = std::min(series.data.size(), m_xDataSet.size());
+    for (int i = 0; i < count; i++)
+        series.decimator.addData(m_xDataSet[i], series.data[i]);
+}
+
+void GraphWidget::renderStaticLayer()
+{
+    const qreal ratio = devicePixelRatioF();
+    m_staticLayer = QPixmap(size() * ratio);
+    m_staticLayer.setDevicePixelRatio(ratio);
+    m_staticLayer.fill(Qt::transparent);
+
+    QPainter painter(&m_staticLayer);
+
     drawBackground(painter);
     drawGrid(painter);
     drawBorder(painter);
     drawXAxis(painter);
     drawYAxis(painter);
-    drawXLabels(painter);
-    drawYLabels(painter);
-    drawGraph(painter);
 
+    m_staticLayerValid = true;
 }
 
 void GraphWidget::drawBackground(QPainter& painter)
@@ -139,9 +411,6 @@ void GraphWidget::drawXAxis(QPainter& painter)
 {
     m_style.axisStyle(painter);
 
-    if (m_ticksMatchData)
-        setXTicks(m_xDataSet.size());
-
     for(auto value : m_xAxis.values())
     {
         QPointF startPoint = m_window.xAxisMarginStartPoint(value);
@@ -164,7 +433,7 @@ void GraphWidget::drawYAxis(QPainter& painter)
     }
 }
 
-void GraphWidget::drawXLabels(QPainter& painter)
+void GraphWidget::drawXLabels(QPainter& painter, const std::pair<double, double>& dataRange)
 {
     m_style.labelStyle(painter);
 
@@ -173,7 +442,6 @@ void GraphWidget::drawXLabels(QPainter& painter)
     {
         if (++labelCount % m_xLabelSkip) {
             QPointF textPoint = m_window.xAxisTextPoint(value);
-            std::pair<double, double> dataRange = m_xDataSet.range();
 
             QString label = QString::number(m_xAxis.fitAxisValueToRange(value, dataRange),
                                             'g', 3);
@@ -182,7 +450,7 @@ void GraphWidget::drawXLabels(QPainter& painter)
     }
 }
 
-void GraphWidget::drawYLabels(QPainter& painter)
+void GraphWidget::drawYLabels(QPainter& painter, const std::pair<double, double>& dataRange)
 {
     m_style.labelStyle(painter);
 
@@ -191,7 +459,6 @@ void GraphWidget::drawYLabels(QPainter& painter)
     {
         if (++labelCount % m_yLabelSkip) {
             QPointF textPoint = m_window.yAxisTextPoint(value);
-            std::pair<double, double> dataRange = m_yDataSet.range();
 
             QString label = QString::number(m_yAxis.fitAxisValueToRange(value, dataRange),
                                             'g', 3);
@@ -200,33 +467,137 @@ void GraphWidget::drawYLabels(QPainter& painter)
     }
 }
 
+void GraphWidget::drawLegend(QPainter& painter, const std::vector<std::pair<double, double>>& dataRanges)
+{
+    // Only series 0 has y labels; every series gets its name and the range its scale spans
+    if (m_series.size() < 2)
+        return;
+
+    m_style.labelStyle(painter);
+    const QPointF borderPosition = m_window.borderPosition();
+    const double lineHeight = painter.fontMetrics().height();
+    QPointF textPoint(borderPosition.x() + lineHeight / 2, borderPosition.y() + lineHeight);
+
+    for (std::size_t i = 0; i < std::min(m_series.size(), dataRanges.size()); i++) {
+        const std::pair<double, double>& range = dataRanges[i];
+        QString text = QString("%1 [%2, %3]").arg(m_series[i].name.isEmpty() ? QString::number(i) : m_series[i].name)
+                                             .arg(QString::number(range.first, 'g', 3))
+                                             .arg(QString::number(range.second, 'g', 3));
+        painter.setPen(m_style.graphLinePen(static_cast<int>(i)).color());
+        painter.drawText(textPoint, text);
+        textPoint.ry() += lineHeight;
+    }
+}
+
 void GraphWidget::drawGraph(QPainter& painter)
 {
-    QPointF precedingPoint;
-    for(int i = 0; i < m_yDataSet.size(); i++)
-    {
-        double yValue = m_yDataSet[i];
-        double xValue = m_xDataSet[i];
+    mapXPixels();
+    for (int i = 0; i < static_cast<int>(m_series.size()); i++) {
+        buildSeries(i);
 
-        std::pair<double, double> yDataRange = m_yDataSet.range();
-        std::pair<double, double> xDataRange = m_xDataSet.range();
+        m_style.graphMarkerStyle(painter, i);
+        painter.drawPoints(m_graphPolygon);
 
-        double y = m_yAxis.fitRangeValueToAxis(yValue, yDataRange);
-        double x = m_xAxis.fitRangeValueToAxis(xValue, xDataRange);
+        m_style.graphLineStyle(painter, i);
+        painter.drawPolyline(m_graphPolygon);
+    }
+}
 
-        QPointF borderPosition = m_window.borderPosition();
-        QSizeF borderSize = m_window.borderSize();
-        QPointF graphPoint(borderPosition.x() + x,
-                          borderPosition.y() + borderSize.height() - y);
+void GraphWidget::requestFrame()
+{
+    // Polygons are built here, O(pixels) after decimation; the antialiased rasterizing is the costly part
+    // Also called from the rendered handler, outside a paint, so the ranges are brought up to date here
+    updateFrameRanges();
+
+    GraphRenderer::Frame frame;
+    frame.size = size();
+    frame.ratio = devicePixelRatioF();
+
+    mapXPixels();
+    for (int i = 0; i < static_cast<int>(m_series.size()); i++) {
+        buildSeries(i);
+        frame.layers.push_back({m_graphPolygon, m_style.graphMarkerPen(i), m_style.graphLinePen(i)});
+    }
+    frame.ranges = {m_frameXRange, m_frameYRanges};
 
-        m_style.graphMarkerStyle(painter);
-        painter.drawPoint(graphPoint);
+    m_dataDirty = false;
+    m_frameBusy = true;
+    GraphRenderer::instance().submit(reinterpret_cast<quintptr>(this), ++m_frameSerial, frame);
+}
 
-        if (i > 0) {
-            m_style.graphLineStyle(painter);
-            painter.drawLine(precedingPoint, graphPoint);
+void GraphWidget::mapXPixels()
+{
+    // The x axis is shared, so live sample positions are mapped once for all series
+    m_xPixels.clear();
+    if (m_live) {
+        const double left = m_window.borderPosition().x();
+        const auto xSpans = m_xDataSet.spans();
+        for (const auto& span : {xSpans.first, xSpans.second}) {
+            for (double xValue : span)
+                m_xPixels.push_back(left + m_xAxis.fitRangeValueToAxis(xValue, m_frameXRange));
         }
+    }
+}
+
+void GraphWidget::buildSeries(const int index)
+{
+    const Series& series = m_series[static_cast<std::size_t>(index)];
+    const std::pair<double, double>& xDataRange = m_frameXRange;
+    const std::pair<double, double>& yDataRange = m_frameYRanges[static_cast<std::size_t>(index)];
+    const QPointF borderPosition = m_window.borderPosition();
+    const double bottom = borderPosition.y() + m_window.borderSize().height();
 
-        precedingPoint = graphPoint;
+    auto toPoint = [&](double xValue, double yValue) {
+        double y = m_yAxis.fitRangeValueToAxis(yValue, yDataRange);
+        double x = m_xAxis.fitRangeValueToAxis(xValue, xDataRange);
+        return QPointF(borderPosition.x() + x, bottom - y);
+    };
+
+    const int count = std::min(series.data.size(), static_cast<int>(m_xPixels.size()));
+    if (!m_live) {
+        // Zoomed: each pyramid bucket is a vertical stroke from its minimum to its maximum
+        m_graphPolygon.resize(2 * static_cast<int>(series.view.size()));
+        int i = 0;
+        for (const auto& node : series.view) {
+            const double xValue = (node.firstX + node.lastX) / 2;
+            m_graphPolygon[i++] = toPoint(xValue, node.minY);
+            m_graphPolygon[i++] = toPoint(xValue, node.maxY);
+        }
+    }
+    else if (count > 2 * m_xAxis.getLength()) {
+        // More samples than pixels: the minimum and maximum of each bucket, in sample order
+        const auto& buckets = series.decimator.buckets();
+        m_graphPolygon.resize(2 * static_cast<int>(buckets.size()));
+        const GraphDecimator::Bucket front = series.decimator.front(m_xDataSet, series.data);
+        int i = 0;
+        for (auto it = buckets.begin(); it != buckets.end(); ++it) {
+            const GraphDecimator::Bucket& bucket = (it == buckets.begin()) ? front : *it;
+            if (std::isnan(bucket.minY))
+                continue;
+            QPointF low = toPoint(bucket.minX, bucket.minY);
+            QPointF high = toPoint(bucket.maxX, bucket.maxY);
+            m_graphPolygon[i++] = bucket.minFirst ? low : high;
+            m_graphPolygon[i++] = bucket.minFirst ? high : low;
+        }
+        m_graphPolygon.resize(i);
+    }
+    else {
+        // Both data sets are filled and trimmed together, so their spans line up
+        const auto ySpans = series.data.spans();
+        m_graphPolygon.resize(count);
+        int i = 0;
+        int points = 0;
+        for (const auto& span : {ySpans.first, ySpans.second}) {
+            for (double yValue : span) {
+                if (i == count)
+                    break;
+                // Skipped samples are left out, the line joins their neighbours
+                if (!std::isnan(yValue))
+                    m_graphPolygon[points++] = QPointF(m_xPixels[static_cast<std::size_t>(i)],
+                                                       bottom - m_yAxis.fitRangeValueToAxis(yValue, yDataRange));
+                i++;
+            }
+        }
+        m_graphPolygon.resize(points);
     }
 }
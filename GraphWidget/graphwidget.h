@@ -2,11 +2,18 @@
 #define GRAPHWIDGET_H
 
 #include <QWidget>
+#include <QPolygonF>
+#include <QPixmap>
+#include <QImage>
+#include <vector>
 
 #include "graphwindow.h"
 #include "graphaxis.h"
 #include "graphdataset.h"
+#include "graphdecimator.h"
+#include "graphpyramid.h"
 #include "graphstyler.h"
+#include "graphrenderer.h"
 
 class GraphWidget : public QWidget
 {
@@ -14,10 +21,21 @@ class GraphWidget : public QWidget
 public:
     explicit GraphWidget(int width = 400, int height = 200, QWidget* parent = nullptr);
 
+    // Series 0 exists from the start; further series share the x samples, each with its own y scaling.
+    // With more than one series a legend names them and gives the range each one spans
+    int addSeries(const QString& name = QString());
+    int seriesCount() const;
+    void setSeriesName(const int index, const QString& name);
     void addData(double xData, double yData);
+    // A NaN y value skips that series for this sample
+    void addData(double xData, const std::vector<double>& yData);
     void setSampleBufferSize(const int size);
+    // Samples kept for zooming out and panning back, beyond the sample buffer
+    void setHistorySize(const int size);
 
     void setTheme(const GraphStyler::GraphThemeSelection theme);
+    // The data layer is rasterized on the GraphRenderer thread, paintEvent only blits it
+    void setThreadedRendering(const bool threaded);
 
     void setXTicks(const int ticks);
     void setYTicks(const int ticks);
@@ -28,16 +46,43 @@ public:
 
 protected:
     void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    // Wheel zooms, dragging pans, a double click returns to the live sample buffer
+    void wheelEvent(QWheelEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void mouseReleaseEvent(QMouseEvent* event) override;
+    void mouseDoubleClickEvent(QMouseEvent* event) override;
 
 private:
+    struct Series {
+        QString name;
+        GraphDataSet data;
+        GraphDecimator decimator;   // Drawn instead of the samples once they outnumber the pixels
+        GraphPyramid history;       // Drawn while zoomed or panned away from the live buffer
+        std::vector<GraphPyramid::Node> view;
+    };
+
+    void invalidateStaticLayer();
+    void updateFrameRanges();
+    void leaveLive();
+    void clampView();
+    void matchTicksToData();
+    void rebuildDecimation(Series& series);
+    void renderStaticLayer();
     void drawBackground(QPainter& painter);
     void drawGrid(QPainter& painter);
     void drawBorder(QPainter& painter);
     void drawXAxis(QPainter& painter);
     void drawYAxis(QPainter& painter);
-    void drawXLabels(QPainter& painter);
-    void drawYLabels(QPainter& painter);
+    void drawXLabels(QPainter& painter, const std::pair<double, double>& dataRange);
+    void drawYLabels(QPainter& painter, const std::pair<double, double>& dataRange);
+    void drawLegend(QPainter& painter, const std::vector<std::pair<double, double>>& dataRanges);
     void drawGraph(QPainter& painter);
+    void requestFrame();
+    void mapXPixels();
+    // Maps a series into m_graphPolygon
+    void buildSeries(const int index);
 
 private:
     int m_width;
@@ -48,11 +93,36 @@ private:
     GraphAxis m_xAxis;
     GraphAxis m_yAxis;
     GraphDataSet m_xDataSet;
-    GraphDataSet m_yDataSet;
+    std::vector<Series> m_series;   // The y labels follow series 0
 
     bool m_ticksMatchData;
     int m_xLabelSkip;
     int m_yLabelSkip;
+
+    QPolygonF m_graphPolygon;       // Reused between series and frames, keeps its capacity
+    std::vector<double> m_xPixels;  // Sample x positions, mapped once per frame for every series
+
+    bool m_live;                    // Showing the sample buffer rather than a zoomed history view
+    double m_viewSpan;
+    double m_viewEnd;
+    bool m_dragging;
+    int m_dragStartX;
+    double m_dragStartEnd;
+    std::pair<double, double> m_frameXRange;
+    std::vector<std::pair<double, double>> m_frameYRanges;
+
+    bool m_threaded;
+    bool m_dataDirty;               // Data, view, size or style changed since the last frame was requested
+    bool m_frameBusy;               // A frame is on the render thread
+    quint64 m_frameSerial;
+    QImage m_dataLayer;
+    GraphRenderer::Ranges m_dataLayerRanges;
+
+    const double MIN_VIEW_SPAN = 1e-3;  // [x units] Zooming in stops here
+
+    // Background, grid, border and axes, redrawn only on resize and theme or tick changes
+    QPixmap m_staticLayer;
+    bool m_staticLayerValid;
 };
 
 #endif // GRAPHWIDGET_H
@@ -0,0 +1,101 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+// Bounded multi-producer/multi-consumer queue without locks (Vyukov's sequence ring)
+template<typename T>
+class BoundedQueue
+{
+public:
+    // The capacity is rounded up to a power of two
+    explicit BoundedQueue(std::size_t capacity)
+        : m_size(roundUp(capacity))
+        , m_mask(m_size - 1)
+        , m_cells(new Cell[m_size])
+        , m_enqueue(0)
+        , m_dequeue(0)
+    {
+        for (std::size_t i = 0; i < m_size; ++i) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue &operator=(const BoundedQueue&) = delete;
+
+    // Leaves the value untouched and returns false when the queue is full
+    bool push(T &value)
+    {
+        auto position = m_enqueue.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &m_cells[position & m_mask];
+            auto sequence = cell->sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+            if (difference == 0) {
+                if (m_enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = m_enqueue.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(value);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &value)
+    {
+        auto position = m_dequeue.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &m_cells[position & m_mask];
+            auto sequence = cell->sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+            if (difference == 0) {
+                if (m_dequeue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = m_dequeue.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->data);
+        cell->sequence.store(position + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::size_t capacity() const
+    {
+        return m_size;
+    }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T data;
+    };
+    static std::size_t roundUp(std::size_t capacity)
+    {
+        std::size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    const std::size_t m_size;
+    const std::size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+    alignas(64) std::atomic<std::size_t> m_enqueue;
+    alignas(64) std::atomic<std::size_t> m_dequeue;
+};
+
+#endif // BOUNDEDQUEUE_H
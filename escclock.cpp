@@ -0,0 +1,214 @@
+#include "escclock.h"
+#include <QDateTime>
+#include <QCoreApplication>
+#include <algorithm>
+
+EscClock *EscClock::s_clock = nullptr;
+
+
+EscTicker::EscTicker(QObject *parent)
+    : QObject(parent)
+{
+
+}
+
+EscClock &EscClock::instance()
+{
+    static SystemClock system;
+    return (s_clock != nullptr) ? *s_clock : system;
+}
+
+void EscClock::setInstance(EscClock *clock)
+{
+    s_clock = clock;
+}
+
+EscStopwatch::EscStopwatch()
+    : m_start(0)
+{
+
+}
+
+void EscStopwatch::start()
+{
+    m_start = EscClock::instance().now();
+}
+
+int EscStopwatch::restart()
+{
+    auto now = EscClock::instance().now();
+    auto elapsed = static_cast<int>(now - m_start);
+    m_start = now;
+    return elapsed;
+}
+
+int EscStopwatch::elapsed() const
+{
+    return static_cast<int>(EscClock::instance().now() - m_start);
+}
+
+qint64 SystemClock::now() const
+{
+    return QDateTime::currentMSecsSinceEpoch();
+}
+
+EscTicker *SystemClock::createTicker(QObject *parent)
+{
+    return new SystemTicker(parent);
+}
+
+SystemTicker::SystemTicker(QObject *parent)
+    : EscTicker(parent)
+{
+    connect(&m_timer, &QTimer::timeout, this, &EscTicker::timeout);
+}
+
+void SystemTicker::start(const int interval)
+{
+    m_timer.start(interval);
+}
+
+void SystemTicker::stop()
+{
+    m_timer.stop();
+}
+
+bool SystemTicker::isActive() const
+{
+    return m_timer.isActive();
+}
+
+int SystemTicker::interval() const
+{
+    return m_timer.interval();
+}
+
+void SystemTicker::setInterval(const int interval)
+{
+    m_timer.setInterval(interval);
+}
+
+VirtualClock::VirtualClock()
+    : m_now(0)
+{
+
+}
+
+VirtualClock::~VirtualClock()
+{
+    for (auto ticker: m_tickers) {
+        ticker->m_clock = nullptr;
+    }
+}
+
+qint64 VirtualClock::now() const
+{
+    return m_now;
+}
+
+EscTicker *VirtualClock::createTicker(QObject *parent)
+{
+    return new VirtualTicker(*this, parent);
+}
+
+void VirtualClock::advance(const qint64 duration)
+{
+    const auto target = m_now + duration;
+    while (true) {
+        VirtualTicker *next = nullptr;
+        for (auto ticker: m_tickers) {
+            if (ticker->isActive() && ticker->due() <= target && (next == nullptr || ticker->due() < next->due())) {
+                next = ticker;
+            }
+        }
+        if (next == nullptr) {
+            break;
+        }
+        m_now = std::max(m_now, next->due());
+        next->fire();
+    }
+    m_now = target;
+    // Tests and slots retire themselves with deleteLater()
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
+
+bool VirtualClock::runUntil(const std::function<bool()> &done, const qint64 timeout, const qint64 step)
+{
+    const auto deadline = m_now + timeout;
+    while (!done()) {
+        if (m_now >= deadline) {
+            return false;
+        }
+        advance(std::min(step, deadline - m_now));
+    }
+    return true;
+}
+
+void VirtualClock::attach(VirtualTicker *ticker)
+{
+    m_tickers.push_back(ticker);
+}
+
+void VirtualClock::detach(VirtualTicker *ticker)
+{
+    m_tickers.erase(std::remove(m_tickers.begin(), m_tickers.end(), ticker), m_tickers.end());
+}
+
+VirtualTicker::VirtualTicker(VirtualClock &clock, QObject *parent)
+    : EscTicker(parent)
+    , m_clock(&clock)
+    , m_interval(0)
+    , m_due(0)
+    , m_active(false)
+{
+    m_clock->attach(this);
+}
+
+VirtualTicker::~VirtualTicker()
+{
+    if (m_clock != nullptr) {
+        m_clock->detach(this);
+    }
+}
+
+void VirtualTicker::start(const int interval)
+{
+    m_interval = std::max(interval, 1);
+    m_due = ((m_clock != nullptr) ? m_clock->now() : 0) + m_interval;
+    m_active = true;
+}
+
+void VirtualTicker::stop()
+{
+    m_active = false;
+}
+
+bool VirtualTicker::isActive() const
+{
+    return m_active;
+}
+
+int VirtualTicker::interval() const
+{
+    return m_interval;
+}
+
+void VirtualTicker::setInterval(const int interval)
+{
+    if (m_active) {
+        start(interval);
+    } else {
+        m_interval = std::max(interval, 1);
+    }
+}
+
+qint64 VirtualTicker::due() const
+{
+    return m_due;
+}
+
+void VirtualTicker::fire()
+{
+    m_due += m_interval;
+    emit timeout();
+}
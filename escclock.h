@@ -0,0 +1,118 @@
+#ifndef ESCCLOCK_H
+#define ESCCLOCK_H
+
+#include <QObject>
+#include <QTimer>
+#include <vector>
+#include <functional>
+
+class EscTicker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit EscTicker(QObject *parent = nullptr);
+    virtual void start(const int interval) = 0;
+    virtual void stop() = 0;
+    virtual bool isActive() const = 0;
+    virtual int interval() const = 0;
+    virtual void setInterval(const int interval) = 0;
+
+signals:
+    void timeout();
+};
+
+class EscClock
+{
+public:
+    virtual ~EscClock() = default;
+    virtual qint64 now() const = 0;                                 // [Milliseconds]
+    virtual EscTicker *createTicker(QObject *parent) = 0;
+
+    static EscClock &instance();
+    static void setInstance(EscClock *clock);                       // nullptr restores the system clock
+
+private:
+    static EscClock *s_clock;
+};
+
+class EscStopwatch
+{
+public:
+    EscStopwatch();
+    void start();
+    int restart();
+    int elapsed() const;
+
+private:
+    qint64 m_start;
+};
+
+class SystemClock : public EscClock
+{
+public:
+    qint64 now() const override;
+    EscTicker *createTicker(QObject *parent) override;
+};
+
+class SystemTicker : public EscTicker
+{
+    Q_OBJECT
+public:
+    explicit SystemTicker(QObject *parent = nullptr);
+    void start(const int interval) override;
+    void stop() override;
+    bool isActive() const override;
+    int interval() const override;
+    void setInterval(const int interval) override;
+
+private:
+    QTimer m_timer;
+};
+
+class VirtualTicker;
+class VirtualClock : public EscClock
+{
+public:
+    VirtualClock();
+    ~VirtualClock();
+    qint64 now() const override;
+    EscTicker *createTicker(QObject *parent) override;
+
+    void advance(const qint64 duration);
+    bool runUntil(const std::function<bool()> &done, const qint64 timeout, const qint64 step = 1000);
+
+protected:
+    friend class VirtualTicker;
+    void attach(VirtualTicker *ticker);
+    void detach(VirtualTicker *ticker);
+
+private:
+    qint64 m_now;
+    std::vector<VirtualTicker*> m_tickers;
+};
+
+class VirtualTicker : public EscTicker
+{
+    Q_OBJECT
+public:
+    VirtualTicker(VirtualClock &clock, QObject *parent = nullptr);
+    ~VirtualTicker();
+    void start(const int interval) override;
+    void stop() override;
+    bool isActive() const override;
+    int interval() const override;
+    void setInterval(const int interval) override;
+    qint64 due() const;
+    void fire();
+
+protected:
+    friend class VirtualClock;
+
+private:
+    VirtualClock *m_clock;
+    int m_interval;
+    qint64 m_due;
+    bool m_active;
+};
+
+#endif // ESCCLOCK_H
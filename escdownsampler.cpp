@@ -0,0 +1,75 @@
+#include "escdownsampler.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+double EscDownsampler::Field::mean() const
+{
+    return (count > 0) ? sum / count : std::numeric_limits<double>::quiet_NaN();
+}
+
+EscDownsampler::EscDownsampler(const qint64 period, const std::size_t fields)
+    : m_period(std::max<qint64>(period, 1))
+    , m_fields(fields)
+{
+
+}
+
+qint64 EscDownsampler::period() const
+{
+    return m_period;
+}
+
+void EscDownsampler::add(const int unit, const qint64 time, const std::vector<double> &values, std::vector<EscDownsampler::Bucket> &done)
+{
+    auto found = m_open.find(unit);
+    if (found == m_open.end()) {
+        found = m_open.emplace(unit, Bucket()).first;
+        open(found->second, unit, time);
+    } else if (time >= found->second.start + m_period) {
+        done.push_back(std::move(found->second));
+        open(found->second, unit, time);
+    }
+
+    auto &bucket = found->second;
+    ++bucket.samples;
+    for (std::size_t i = 0; i < m_fields && i < values.size(); ++i) {
+        if (std::isnan(values[i])) {
+            continue;
+        }
+        auto &field = bucket.fields[i];
+        field.min = std::min(field.min, values[i]);
+        field.max = std::max(field.max, values[i]);
+        field.sum += values[i];
+        ++field.count;
+    }
+}
+
+void EscDownsampler::expire(const qint64 time, std::vector<EscDownsampler::Bucket> &done)
+{
+    for (auto it = m_open.begin(); it != m_open.end(); ) {
+        if (time >= it->second.start + m_period) {
+            done.push_back(std::move(it->second));
+            it = m_open.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void EscDownsampler::drain(std::vector<EscDownsampler::Bucket> &done)
+{
+    for (auto& bucket: m_open) {
+        done.push_back(std::move(bucket.second));
+    }
+    m_open.clear();
+}
+
+void EscDownsampler::open(EscDownsampler::Bucket &bucket, const int unit, const qint64 time) const
+{
+    // Buckets are aligned to the period, so tiers of different units line up
+    bucket.unit = unit;
+    bucket.start = time - time % m_period;
+    bucket.samples = 0;
+    bucket.fields.assign(m_fields, {std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(), 0.0, 0});
+}
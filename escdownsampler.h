@@ -0,0 +1,43 @@
+#ifndef ESCDOWNSAMPLER_H
+#define ESCDOWNSAMPLER_H
+
+#include <QtGlobal>
+#include <vector>
+#include <map>
+
+// Folds samples into fixed time buckets per unit, keeping min, mean and max of every field
+class EscDownsampler
+{
+public:
+    struct Field {
+        double min;
+        double max;
+        double sum;
+        int count;                          // NaN samples are not counted
+        double mean() const;
+    };
+    struct Bucket {
+        int unit;
+        qint64 start;                       // [Milliseconds since epoch]
+        int samples;
+        std::vector<Field> fields;
+    };
+
+    EscDownsampler(const qint64 period, const std::size_t fields);
+    qint64 period() const;
+    // A bucket the sample falls past is closed and appended to done
+    void add(const int unit, const qint64 time, const std::vector<double> &values, std::vector<Bucket> &done);
+    // Closes the buckets that ended by time, for units that stopped sampling
+    void expire(const qint64 time, std::vector<Bucket> &done);
+    void drain(std::vector<Bucket> &done);
+
+protected:
+    void open(Bucket &bucket, const int unit, const qint64 time) const;
+
+private:
+    qint64 m_period;                        // [Milliseconds]
+    std::size_t m_fields;
+    std::map<int, Bucket> m_open;
+};
+
+#endif // ESCDOWNSAMPLER_H
@@ -1,131 +1,135 @@
 #include "escfunctest.h"
 #include <QDebug>
+#include <algorithm>
 
 EscFuncTest::Limits EscFuncTest::s_limit;
 EscFuncTest::Durations EscFuncTest::s_duration;
-const QString EscFuncTest::VERSION = "2.00.04";
+TestPlan EscFuncTest::s_plan;
+std::vector<EscFuncTest::Step> EscFuncTest::s_program;
 
 
 EscFuncTest::EscFuncTest(WingSlot &unit, QObject *parent)
     : QObject(parent)
     , m_unit(unit)
     , m_state(State::NONE)
+    , m_step(0)
+    , m_waiting(false)
+    , m_gate(nullptr)
     , m_OK(true)
+    , m_ticker(EscClock::instance().createTicker(this))
+    , m_settled(false)
 {
-    m_log.setTitle("Activity_Test_118_eBird_Wing");
-    m_log.setPath("~/PALM/log");
-
-    m_log.addColumn("TestVersion");
-    m_log.addColumn("Approved");
-    m_log.addColumn("PairingElapsed");
-    m_log.addColumn("WingSerial");
-    m_log.addColumn("MeasuringDuration_noCharge");
-    m_log.addColumn("iSupply_noCharge");
-    m_log.addColumn("iSupplyWing_noCharge");
-    m_log.addColumn("MeasurigDuration_charge");
-    m_log.addColumn("iSupply_charge");
-    m_log.addColumn("iSupplyWing_charge");
-    m_log.addColumn("MeasuringDuration_noLoad"); // To be implemented
-    m_log.addColumn("iSupply_noLoad"); // To be implemented
-    m_log.addColumn("iSupplyWing_noLoad"); // To be implemented
-    m_log.addColumn("WingBatCapacity");
-    m_log.addColumn("WingBatCurrent");
-    m_log.addColumn("WingBatVolt");
-    m_log.addColumn("WingHumidity");
-    m_log.addColumn("WingLoss");
-    m_log.addColumn("WingLqi");
-    m_log.addColumn("WingTemperature");
-    m_log.addColumn("SlotLoss");
-    m_log.addColumn("SlotLqi");
-    m_log.addColumn("SlotTemperature");
-
-    m_log.setValue("Product", QString("eB-WCB_001"));
+    m_log.setTitle(s_plan.title());
+    m_log.setPath(s_plan.path());
+    m_log.addColumn(s_plan.columns());
+    m_log.setSync(true);
+    m_log.setAtomic(true);
+    m_log.setIndexed(true);
+
+    m_log.setValue("Product", s_plan.product());
     m_log.setValue("SerialNo", m_unit.id());
-    m_log.setValue("ProductFamily", QString("eBird"));
+    m_log.setValue("ProductFamily", s_plan.productFamily());
     m_log.setValue("FirmwareVersion", m_unit.stats().firmware);
 
-    connect(&m_ticker, &QTimer::timeout, this,
+    connect(&m_unit, &WingSlot::new_data, this,
+            [=](const WingSlot::Stats &stats){
+        if (!isRunning() || m_waiting || m_settled) {
+            return;
+        }
+        const auto &settle = s_program[m_step].phase->settle;
+        if (settle.detect) {
+            m_settle.addData(m_phaseWatch.elapsed() / 1000.0, TestPlan::value(stats, settle.field));
+        }
+    });
+
+    connect(m_ticker, &EscTicker::timeout, this,
             [=](){
-        switch (m_state) {
-        case State::NONE :
-            m_unit.setCharge(false);
-            m_passiveWatch.start();
-            m_state = State::PASSIVE;
-            break;
-
-        case State::PASSIVE :
-            if (m_passiveWatch.elapsed() > INERTIA_DELAY) {
-                sampleData();
+        if (m_waiting) {
+            enterPhase(m_step);
+            return;
+        }
+
+        if (m_state == State::NONE) {
+            if (s_program.empty()) {
+                emit error(QString("Internal error; no test plan loaded!"));
+                stop();
+                return;
             }
-            if (m_passiveWatch.elapsed() > s_duration.passive) {
-                emit finished(m_state, evaluate());
-                m_log.setValue("MeasuringDuration_noCharge", s_duration.passive);
-                m_unit.setCharge(true);
-                m_pairingWatch.start();
-                m_state = State::PAIRING;
+            if (m_step >= s_program.size()) {
+                m_state = State::DONE;
+                return;
             }
-            break;
+            enterPhase(m_step);
+            return;
+        }
 
-        case State::PAIRING :
+        if (m_state == State::DONE) {
+            // Saved before reporting, so the journal never drops a unit whose row is not on disk.
+            // The state stays DONE until then, a checkpoint taken meanwhile records completion
+            m_ticker->stop();
+            claim(Resources());
+            m_log.setValue("TestVersion", s_plan.version());
+            record(s_plan.records());
+            m_log.setValue("Approved", m_OK);
+            m_log.save();
+            emit finished(State::DONE, m_OK, m_feedback);
+            stop();
+            return;
+        }
+
+        const auto &step = s_program[m_step];
+        const auto &phase = *step.phase;
+        if (phase.completion == TestPlan::Completion::PAIRED) {
             if (m_unit.isPaired()) {
                 emit finished(m_state, true);
-                m_log.setValue("PairingElapsed", m_pairingWatch.elapsed());
-                m_activeWatch.start();
-                m_state = State::ACTIVE;
-            } else if (m_pairingWatch.elapsed() > s_duration.pairing) {
-                emit finished(m_state, false, QString("Pairing timed out!"));
+                m_log.setValue(phase.elapsedColumn, m_phaseWatch.elapsed());
+                nextPhase();
+            } else if (m_phaseWatch.elapsed() > *step.duration) {
+                emit finished(m_state, false, phase.timeoutMessage);
                 m_OK = false;
-                m_log.setValue("PairingElapsed", s_duration.pairing);
+                m_log.setValue(phase.elapsedColumn, *step.duration);
                 m_state = State::DONE;
-            } else {
+                emit progressed();
+            } else if (phase.pair) {
                 m_unit.pair();
             }
-            break;
+            return;
+        }
 
-        case State::ACTIVE :
-            if (m_activeWatch.elapsed() > INERTIA_DELAY) {
-                sampleData();
-            }
-            if (m_activeWatch.elapsed() > s_duration.active) {
-                emit finished(m_state, evaluate());
-                m_log.setValue("MeasurigDuration_charge", s_duration.active);
-                if (m_unit.stats().wing.dataPresent) {
-                    m_log.setValue("WingSerial", m_unit.stats().wing.serial);
-                    m_log.setValue("WingBatCapacity", m_unit.stats().wing.batCapacity);
-                    m_log.setValue("WingBatVolt", m_unit.stats().wing.batVolt);
-                    m_log.setValue("WingHumidity", m_unit.stats().wing.humidity);
-                    m_log.setValue("WingTemperature", m_unit.stats().wing.temperature);
-                }
-                m_state = State::DONE;
+        if (!m_settled) {
+            m_settled = (phase.settle.detect && m_settle.isSettled()) || m_phaseWatch.elapsed() > phase.settle.maxDelay;
+        }
+        if (m_settled) {
+            sampleData();
+            if (!isRunning()) {
+                return;
             }
-            break;
-
-        case State::DONE :
-            emit finished(m_state, m_OK, m_feedback);
-            stop();
-            m_log.setValue("TestVersion", VERSION);
-            m_log.setValue("SlotTemperature", m_unit.stats().temperature);
-            m_log.setValue("Approved", m_OK);
-            m_log.save();
-            break;
+        }
+        if (m_phaseWatch.elapsed() > *step.duration) {
+            emit finished(m_state, evaluate());
+            m_log.setValue(phase.durationColumn, *step.duration);
+            record(phase.records);
+            nextPhase();
         }
     });
 }
 
 void EscFuncTest::start(const int interval)
 {
-    if (m_ticker.isActive()) {
-        m_ticker.setInterval(interval);
+    if (m_ticker->isActive()) {
+        m_ticker->setInterval(interval);
     } else {
-        m_ticker.start(interval);
+        m_ticker->start(interval);
     }
 }
 
 void EscFuncTest::stop()
 {
-    if (m_ticker.isActive()) {
-        m_ticker.stop();
+    if (m_ticker->isActive()) {
+        m_ticker->stop();
     }
+    claim(Resources());
+    m_waiting = false;
     m_state = State::NONE;
 }
 
@@ -134,6 +138,43 @@ bool EscFuncTest::isRunning() const
     return m_state != State::NONE && m_state != State::DONE;
 }
 
+QJsonObject EscFuncTest::checkpoint() const
+{
+    QJsonObject values;
+    const auto &schema = m_log.schema();
+    for (PALM::Column column = 0; column < schema.size(); ++column) {
+        auto value = m_log.value(column);
+        if (value.isValid()) {
+            values[schema.name(column)] = QJsonValue::fromVariant(value);
+        }
+    }
+
+    QJsonObject checkpoint;
+    checkpoint["unit"] = m_unit.id();
+    checkpoint["step"] = static_cast<int>((m_state == State::DONE) ? s_program.size() : m_step);
+    checkpoint["approved"] = m_OK;
+    checkpoint["feedback"] = m_feedback;
+    checkpoint["values"] = values;
+    return checkpoint;
+}
+
+bool EscFuncTest::restore(const QJsonObject &checkpoint)
+{
+    auto step = checkpoint["step"].toInt(0);
+    if (isRunning() || checkpoint["unit"].toInt() != m_unit.id() || step < 0 || step > static_cast<int>(s_program.size())) {
+        return false;
+    }
+    // The phase in progress restarts, completed phases keep their logged results
+    m_step = static_cast<std::size_t>(step);
+    m_OK = checkpoint["approved"].toBool(true);
+    m_feedback = checkpoint["feedback"].toString();
+    auto values = checkpoint["values"].toObject();
+    for (auto it = values.begin(); it != values.end(); ++it) {
+        m_log.setValue(it.key(), it.value().toVariant());
+    }
+    return true;
+}
+
 void EscFuncTest::setLimits(const EscFuncTest::Limits &limits)
 {
     s_limit = limits;
@@ -154,132 +195,210 @@ EscFuncTest::Durations EscFuncTest::getDuration()
     return s_duration;
 }
 
-void EscFuncTest::sampleData()
+bool EscFuncTest::setPlan(const TestPlan &plan, QString &error)
 {
-    m_iSupplySamples.push_back(m_unit.stats().iSupply);
-    m_iSupplyWingSamples.push_back(m_unit.stats().iSupplyWing);
-    if (m_state == State::ACTIVE) {
-        if (m_unit.stats().wing.dataPresent) {
-            m_slotLQISamples.push_back(m_unit.stats().LQI);
-            m_wingLQISamples.push_back(m_unit.stats().wing.LQI);
-            m_wingLossSamples.push_back(m_unit.stats().wing.loss);
+    std::vector<Step> program;
+    if (!compile(plan, program, error)) {
+        return false;
+    }
+    s_plan = plan;
+    return compile(s_plan, s_program, error);
+}
+
+const TestPlan &EscFuncTest::plan()
+{
+    return s_plan;
+}
+
+void EscFuncTest::setGate(EscFuncTest::Gate *gate)
+{
+    m_gate = gate;
+}
+
+bool EscFuncTest::compile(const TestPlan &plan, std::vector<EscFuncTest::Step> &program, QString &error)
+{
+    const std::vector<std::pair<QString, State>> states = {
+        {"PASSIVE", State::PASSIVE},
+        {"PAIRING", State::PAIRING},
+        {"ACTIVE",  State::ACTIVE},
+    };
+    const std::vector<std::pair<QString, const int*>> durations = {
+        {"passive", &s_duration.passive},
+        {"pairing", &s_duration.pairing},
+        {"active",  &s_duration.active},
+    };
+    const std::vector<std::pair<QString, const float*>> limits = {
+        {"iSupply_passive",     &s_limit.iSupply_passive},
+        {"iSupplyWing_passive", &s_limit.iSupplyWing_passive},
+        {"iSupply_active",      &s_limit.iSupply_active},
+        {"iSupplyWing_active",  &s_limit.iSupplyWing_active},
+        {"chargeCurrent",       &s_limit.chargeCurent},
+        {"wingLoss",            &s_limit.wingLoss},
+        {"wingLQI",             &s_limit.wingLQI},
+        {"slotLQI",             &s_limit.slotLQI},
+        {"slotLoss",            &s_limit.slotLoss},
+    };
+
+    program.clear();
+    bool charging = false;
+    for (const auto& phase: plan.phases()) {
+        Step step;
+        step.phase = &phase;
+        if (phase.charge != TestPlan::Charge::KEEP) {
+            charging = (phase.charge == TestPlan::Charge::ON);
+        }
+        step.resources.radio = phase.pair ? 1 : 0;
+        step.resources.power = charging ? 1 : 0;
+
+        auto state = std::find_if(states.begin(), states.end(), [&](const std::pair<QString, State> &entry){
+            return entry.first == phase.state;
+        });
+        if (state == states.end()) {
+            error = QString("Phase [%1] reports unknown state [%2]").arg(phase.name).arg(phase.state);
+            return false;
+        }
+        step.state = state->second;
+
+        if (phase.durationKey.isEmpty()) {
+            step.duration = &phase.duration;
         } else {
-            emit finished(m_state, false, QString("[#%0] lost connection to wing!").arg(m_unit.id()));
-            emit finished(State::DONE, false);
-            stop();
+            auto duration = std::find_if(durations.begin(), durations.end(), [&](const std::pair<QString, const int*> &entry){
+                return entry.first == phase.durationKey;
+            });
+            if (duration == durations.end()) {
+                error = QString("Phase [%1] uses unknown duration [%2]").arg(phase.name).arg(phase.durationKey);
+                return false;
+            }
+            step.duration = duration->second;
         }
+
+        for (const auto& measurement: phase.measurements) {
+            if (measurement.limitKey.isEmpty()) {
+                step.limits.push_back(&measurement.limit);
+                continue;
+            }
+            auto limit = std::find_if(limits.begin(), limits.end(), [&](const std::pair<QString, const float*> &entry){
+                return entry.first == measurement.limitKey;
+            });
+            if (limit == limits.end()) {
+                error = QString("Measurement [%1] uses unknown limit [%2]").arg(measurement.name).arg(measurement.limitKey);
+                return false;
+            }
+            step.limits.push_back(limit->second);
+        }
+        program.push_back(step);
     }
+    return true;
 }
 
-bool EscFuncTest::evaluate()
+void EscFuncTest::enterPhase(const std::size_t step)
 {
-    bool approved = true;
-    if (m_state != State::PASSIVE && m_state != State::ACTIVE) {
-        emit error(QString("Internal error; evaluation on illegal state!"));
-        stop();
-        return false;
+    const auto &phase = *s_program[step].phase;
+    m_step = step;
+    m_waiting = !claim(s_program[step].resources);
+    if (m_waiting) {
+        return;
     }
-
-    if (m_state == State::ACTIVE) {
-        if (!approveRadio())
-            approved = false;
-        if (!approveCharging())
-            approved = false;
+    if (phase.charge != TestPlan::Charge::KEEP) {
+        m_unit.setCharge(phase.charge == TestPlan::Charge::ON);
     }
+    m_samples.assign(phase.measurements.size(), Accumulator());
+    m_settle.reset();
+    m_settle.setWindow(phase.settle.window / 1000.0);
+    m_settle.setSlope(phase.settle.slope);
+    m_settle.setDeviation(phase.settle.deviation);
+    m_settled = false;
+    m_phaseWatch.start();
+    m_state = s_program[step].state;
+    emit progressed();
+}
 
-    if (!approvePower()) {
-        approved = false;
+bool EscFuncTest::claim(const EscFuncTest::Resources &resources)
+{
+    if (m_gate != nullptr && !m_gate->exchange(m_held, resources)) {
+        return false;
     }
+    m_held = resources;
+    return true;
+}
 
-    if (!approved) {
-        m_OK = false;
+void EscFuncTest::nextPhase()
+{
+    if (m_step + 1 < s_program.size()) {
+        enterPhase(m_step + 1);
+    } else {
+        m_state = State::DONE;
+        emit progressed();
     }
-    return approved;
 }
 
-bool EscFuncTest::approveRadio()
+void EscFuncTest::sampleData()
 {
-    bool approved = true;
-    auto slotLQI = std::accumulate(m_slotLQISamples.begin(), m_slotLQISamples.end(), 0.0) / m_slotLQISamples.size();
-    m_log.setValue("SlotLqi", slotLQI);
-    m_slotLQISamples.clear();
-    if (slotLQI < s_limit.slotLQI) {
-        approved = false;
-        m_feedback.append(QString("\n[#%0] read slotLQI[%1] (<%2)")
-                        .arg(m_unit.id())
-                        .arg(slotLQI)
-                        .arg(s_limit.slotLQI));
-    }
-    auto slotLoss = m_unit.stats().loss;
-    m_log.setValue("SlotLoss", slotLoss);
-    if (slotLoss > s_limit.slotLoss) {
-        approved = false;
-        m_feedback.append(QString("\n[#%0] read slotLoss[%1] (>%2)")
-                        .arg(m_unit.id())
-                        .arg(slotLoss)
-                        .arg(s_limit.slotLoss));
-    }
-    auto wingLQI = std::accumulate(m_wingLQISamples.begin(), m_wingLQISamples.end(), 0.0) / m_wingLQISamples.size();
-    m_log.setValue("WingLQI", wingLQI);
-    m_wingLQISamples.clear();
-    if (wingLQI < s_limit.wingLQI) {
-        approved = false;
-        m_feedback.append(QString("\n[#%0] read wingLQI[%1] (<%2)")
-                        .arg(m_unit.id())
-                        .arg(wingLQI)
-                        .arg(s_limit.wingLQI));
+    const auto &phase = *s_program[m_step].phase;
+    const auto &stats = m_unit.stats();
+    if (phase.requireWing && !stats.wing.dataPresent) {
+        emit finished(m_state, false, QString("[#%0] lost connection to wing!").arg(m_unit.id()));
+        emit finished(State::DONE, false);
+        stop();
+        return;
     }
-    auto wingLoss = std::accumulate(m_wingLossSamples.begin(), m_wingLossSamples.end(), 0.0) / m_wingLossSamples.size();
-    m_log.setValue("WingLoss", wingLoss);
-    m_wingLossSamples.clear();
-    if (wingLoss > s_limit.wingLoss) {
-        approved = false;
-        m_feedback.append(QString("\n[#%0] read wingLoss[%1] (>%2)")
-                        .arg(m_unit.id())
-                        .arg(wingLoss)
-                        .arg(s_limit.wingLoss));
+    for (std::size_t i = 0; i < phase.measurements.size(); ++i) {
+        auto value = TestPlan::value(stats, phase.measurements[i].field);
+        m_samples[i].sum += value;
+        m_samples[i].last = value;
+        ++m_samples[i].count;
     }
-    return approved;
 }
 
-bool EscFuncTest::approveCharging()
+bool EscFuncTest::evaluate()
 {
     bool approved = true;
-    if (m_unit.stats().wing.batCurrent < s_limit.chargeCurent) {
-        approved = false;
-        m_feedback.append(QString("\n[#%0] read battery current[%1] (<%2)")
-                        .arg(m_unit.id())
-                        .arg(m_unit.stats().wing.batCurrent)
-                        .arg(s_limit.chargeCurent));
+    if (!isRunning()) {
+        emit error(QString("Internal error; evaluation on illegal state!"));
+        stop();
+        return false;
+    }
+
+    const auto &step = s_program[m_step];
+    for (std::size_t i = 0; i < step.phase->measurements.size(); ++i) {
+        const auto &measurement = step.phase->measurements[i];
+        const auto &samples = m_samples[i];
+        if (samples.count == 0) {
+            approved = false;
+            m_feedback.append(QString("\n[#%0] read no %1 samples")
+                            .arg(m_unit.id())
+                            .arg(measurement.name));
+            continue;
+        }
+
+        auto value = (measurement.reduce == TestPlan::Reduce::MEAN) ? samples.sum / samples.count : samples.last;
+        m_log.setValue(measurement.column, value);
+        auto limit = *step.limits[i];
+        if ((measurement.bound == TestPlan::Bound::MAX && value > limit) ||
+            (measurement.bound == TestPlan::Bound::MIN && value < limit)) {
+            approved = false;
+            m_feedback.append(QString("\n[#%0] read %1[%2] (%3%4)")
+                            .arg(m_unit.id())
+                            .arg(measurement.name)
+                            .arg(value)
+                            .arg((measurement.bound == TestPlan::Bound::MAX) ? ">" : "<")
+                            .arg(limit));
+        }
+    }
+
+    if (!approved) {
+        m_OK = false;
     }
-    m_log.setValue("WingBatCurrent", m_unit.stats().wing.batCurrent);
     return approved;
 }
 
-bool EscFuncTest::approvePower()
+void EscFuncTest::record(const std::vector<TestPlan::Record> &records)
 {
-    bool approved = true;
-    auto iSupply = std::accumulate(m_iSupplySamples.begin(), m_iSupplySamples.end(), 0.0) / m_iSupplySamples.size();
-    m_iSupplySamples.clear();
-    if (iSupply > (double)((m_state == State::PASSIVE) ? s_limit.iSupply_passive : s_limit.iSupply_active)) {
-        approved = false;
-        m_feedback.append(QString("\n[#%0] read iSupply_%1[%2] (>%3)")
-                        .arg(m_unit.id())
-                        .arg((m_state == State::PASSIVE) ? "passive" : "active")
-                        .arg(iSupply)
-                        .arg((m_state == State::PASSIVE) ? s_limit.iSupply_passive : s_limit.iSupply_active));
-    }
-    auto iSupplyWing = std::accumulate(m_iSupplyWingSamples.begin(), m_iSupplyWingSamples.end(), 0.0) / m_iSupplyWingSamples.size();
-    m_iSupplyWingSamples.clear();
-    if (iSupplyWing > (double)((m_state == State::PASSIVE) ? s_limit.iSupplyWing_passive : s_limit.iSupplyWing_active)) {
-        approved = false;
-        m_feedback.append(QString("\n[#%0] read iSupplyWing_%1[%2] (>%3)")
-                        .arg(m_unit.id())
-                        .arg((m_state == State::PASSIVE) ? "passive" : "active")
-                        .arg(iSupplyWing)
-                        .arg((m_state == State::PASSIVE) ? s_limit.iSupplyWing_passive : s_limit.iSupplyWing_active));
+    const auto &stats = m_unit.stats();
+    for (const auto& entry: records) {
+        if (TestPlan::isWingField(entry.field) && !stats.wing.dataPresent) {
+            continue;
+        }
+        m_log.setValue(entry.column, TestPlan::value(stats, entry.field));
     }
-    m_log.setValue(QString("iSupply_%0").arg((m_state == State::PASSIVE) ? "noCharge" : "charge"), m_unit.stats().iSupply);
-    m_log.setValue(QString("iSupplyWing_%0").arg((m_state == State::PASSIVE) ? "noCharge" : "charge"), m_unit.stats().iSupplyWing);
-    return approved;
 }
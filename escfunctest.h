@@ -2,11 +2,13 @@
 #define ESCFUNCTEST_H
 
 #include <QObject>
-#include <QTimer>
-#include <QTime>
+#include <QJsonObject>
 #include <vector>
 #include "wingslot.h"
 #include "palm.h"
+#include "testplan.h"
+#include "settledetector.h"
+#include "escclock.h"
 
 
 class EscFuncTest : public QObject
@@ -17,6 +19,8 @@ public:
     void start(const int interval);
     void stop();
     bool isRunning() const;
+    QJsonObject checkpoint() const;
+    bool restore(const QJsonObject &checkpoint);
 
     enum State {
         NONE,
@@ -45,40 +49,70 @@ public:
     };
     static void setDuration(Durations duration);
     static Durations getDuration();
-    static const QString VERSION;
+    static bool setPlan(const TestPlan &plan, QString &error);
+    static const TestPlan &plan();
+
+    struct Resources {
+        int radio = 0;
+        int power = 0;
+    };
+    class Gate
+    {
+    public:
+        virtual ~Gate() = default;
+        // Trade the held resources for the wanted ones, or keep holding and return false
+        virtual bool exchange(const Resources &held, const Resources &wanted) = 0;
+    };
+    void setGate(Gate *gate);
 
 signals:
     void finished(const State &state, const bool &passed, const QString &message = QString(""));
     void error(const QString &message);
+    void progressed();
 
 protected:
+    void enterPhase(const std::size_t step);
+    bool claim(const Resources &resources);
+    void nextPhase();
     void sampleData();
     bool evaluate();
-    bool approveRadio();
-    bool approveCharging();
-    bool approvePower();
+    void record(const std::vector<TestPlan::Record> &records);
 
 private:
+    struct Step {
+        State state;
+        const TestPlan::Phase *phase;
+        const int *duration;
+        std::vector<const float*> limits;
+        Resources resources;
+    };
+    struct Accumulator {
+        double sum = 0.0;
+        double last = 0.0;
+        int count = 0;
+    };
+    static bool compile(const TestPlan &plan, std::vector<Step> &program, QString &error);
+
     WingSlot &m_unit;
     State m_state;
+    std::size_t m_step;
+    bool m_waiting;
+    Gate *m_gate;
+    Resources m_held;
     static Limits s_limit;
     static Durations s_duration;
+    static TestPlan s_plan;
+    static std::vector<Step> s_program;
     PALM m_log;
     bool m_OK;
     QString m_feedback;
 
-    QTimer m_ticker;
-    QTime m_passiveWatch;
-    QTime m_pairingWatch;
-    QTime m_activeWatch;
-
-    std::vector<float> m_iSupplySamples;
-    std::vector<float> m_iSupplyWingSamples;
-    std::vector<float> m_wingLossSamples;
-    std::vector<float> m_wingLQISamples;
-    std::vector<float> m_slotLQISamples;
+    EscTicker *m_ticker;
+    EscStopwatch m_phaseWatch;
+    SettleDetector m_settle;
+    bool m_settled;
 
-    static const int INERTIA_DELAY = 5000;
+    std::vector<Accumulator> m_samples;
 };
 
 #endif // ESCFUNCTEST_H
@@ -3,6 +3,8 @@
 #include <QHBoxLayout>
 #include <QFormLayout>
 #include <QDebug>
+#include <limits>
+#include "numberformat.h"
 
 EscMonitor::EscMonitor(QWidget *parent)
     : QWidget(parent)
@@ -17,6 +19,12 @@ EscMonitor::EscMonitor(QWidget *parent)
 {
     m_stopwatch.start();
     m_dataGraph->setTheme(GraphStyler::DarkTheme);
+    // Series 0 is the slot supply current, see displayData()
+    m_dataGraph->setSeriesName(0, "Slot [mA]");
+    m_dataGraph->addSeries("Wing [mA]");
+    m_dataGraph->addSeries("Battery [mA]");
+    m_dataGraph->addSeries("Temperature [°C]");
+    m_dataGraph->setThreadedRendering(true);
     setLayout(new QVBoxLayout(this));
     layout()->addWidget(&m_dataPanel);
     auto stats_wrapper = new QWidget(this);
@@ -99,17 +107,17 @@ void EscMonitor::display(WingSlot *unit, bool editable)
 
 void EscMonitor::displayData(const WingSlot::Stats &stats)
 {
-    m_slotTemperature.setText(QString("%0 °C").arg(QString::number(stats.temperature, 'f', DATA_DECIMALS)));
-    m_slotLQI.setText(QString("%0%").arg(QString::number(stats.LQI, 'f', DATA_DECIMALS).remove(QRegExp("\\.?0+$"))));
-    m_slotLoss.setText(QString("%0%").arg(QString::number(stats.loss, 'f', DATA_DECIMALS).remove(QRegExp("\\.?0+$"))));
-    m_slotCurrent.setText(QString("%0 mA").arg(QString::number(stats.iSupply, 'f', DATA_DECIMALS).remove(QRegExp("\\.?0+$"))));
-    m_wingCurrent.setText(QString("%0 mA").arg(QString::number(stats.iSupplyWing, 'f', DATA_DECIMALS).remove(QRegExp("\\.?0+$"))));
+    setNumber(m_slotTemperature, stats.temperature, " °C", false);
+    setNumber(m_slotLQI, stats.LQI, "%");
+    setNumber(m_slotLoss, stats.loss, "%");
+    setNumber(m_slotCurrent, stats.iSupply, " mA");
+    setNumber(m_wingCurrent, stats.iSupplyWing, " mA");
 
     if (m_unit->isPaired()) {
         m_wingSerial.setText(QString("#%0").arg(stats.wing.serial));
-        m_wingTemperature.setText(QString("%0 °C").arg(QString::number(stats.wing.temperature, 'f', DATA_DECIMALS)));
-        m_wingLQI.setText(QString("%0%").arg(QString::number(stats.wing.LQI, 'f', DATA_DECIMALS).remove(QRegExp("\\.?0+$"))));
-        m_wingLoss.setText(QString("%0%").arg(QString::number(stats.wing.loss, 'f', DATA_DECIMALS).remove(QRegExp("\\.?0+$"))));
+        setNumber(m_wingTemperature, stats.wing.temperature, " °C", false);
+        setNumber(m_wingLQI, stats.wing.LQI, "%");
+        setNumber(m_wingLoss, stats.wing.loss, "%");
     } else {
         m_wingSerial.setText("N/A");
         m_wingTemperature.setText("N/A");
@@ -118,7 +126,12 @@ void EscMonitor::displayData(const WingSlot::Stats &stats)
     }
 
 
-    m_dataGraph->addData((double)m_stopwatch.elapsed()/1000, stats.iSupply);
+    m_dataGraph->addData((double)m_stopwatch.elapsed()/1000, {
+                             stats.iSupply,
+                             stats.iSupplyWing,
+                             m_unit->isPaired() ? stats.wing.batCurrent : std::numeric_limits<double>::quiet_NaN(),
+                             stats.temperature,
+                         });
     if (m_unit->isPaired()) {
         m_pairingLED->setGreen();
     } else {
@@ -139,4 +152,9 @@ void EscMonitor::displayData(const WingSlot::Stats &stats)
     }
 }
 
-
+void EscMonitor::setNumber(QLabel &label, const double value, const char *unit, const bool trim)
+{
+    char buffer[NumberFormat::BUFFER_SIZE];
+    auto length = NumberFormat::fixed(buffer, value, DATA_DECIMALS, trim);
+    label.setText(QString::fromLatin1(buffer, length) + QString::fromUtf8(unit));
+}
@@ -25,6 +25,9 @@ signals:
 protected slots:
     void displayData(const WingSlot::Stats &stats);
 
+protected:
+    void setNumber(QLabel &label, const double value, const char *unit, const bool trim = true);
+
 private:
     WingSlot *m_unit;
     QTimer m_poller;
@@ -1,47 +1,91 @@
 #include "escrecorder.h"
+#include <QDir>
+#include <QDateTime>
+#include <cmath>
+#include <limits>
 
 EscRecorder::EscRecorder(WingSlot::SlotList units, QObject *parent)
     : QObject(parent)
     , m_units(units)
+    , m_ticker(EscClock::instance().createTicker(this))
+    , m_mode(Mode::SNAPSHOT)
+    , m_rawRetention(DEFAULT_RAW_RETENTION)
 {
-    m_log.setTitle("eB_WST_002_log");
-    m_log.addColumn("InputCurrent");
-    m_log.addColumn("OutputCurrent");
-    m_log.addColumn("SlotLoss");
-    m_log.addColumn("Temperature");
-    m_log.addColumn("Charging"); // -Age ? Period? Succession? Duration?
-    m_log.addColumn("Pairing"); // -Age ?
-    m_log.addColumn("WingSerial");
-    m_log.addColumn("SlotLQI");
-    m_log.addColumn("WingLQI");
-    m_log.addColumn("WingLoss");
-    m_log.addColumn("WingTemperature");
-
-    connect(&m_ticker, &QTimer::timeout, this,
+    m_snapshot.reserve(m_units.size());
+    m_log.setTitle(TITLE);
+    addColumns(m_log);
+    m_column = {
+        m_log.column("SerialNo"),
+        m_log.column("InputCurrent"),
+        m_log.column("OutputCurrent"),
+        m_log.column("SlotLoss"),
+        m_log.column("Temperature"),
+        m_log.column("Charging"),
+        m_log.column("Pairing"),
+        m_log.column("WingSerial"),
+        m_log.column("SlotLQI"),
+        m_log.column("WingLQI"),
+        m_log.column("WingLoss"),
+        m_log.column("WingTemperature"),
+    };
+    // Ticks are written as one batch, see snapshot()
+    m_log.setRotation(SEGMENT_SIZE, true);
+    m_log.setAtomic(true);
+    m_log.setIndexed(true);
+
+    // Same columns in the same order, so the handles of m_log address the raw log too
+    m_raw.setTitle(RAW_TITLE);
+    addColumns(m_raw);
+    m_raw.setFlushPolicy(PALM::Flush::INTERVAL, TIER_TICK);
+    // Not indexed: an entry per sample would outgrow the index, the tiers summarize it instead
+    m_raw.setRotation(SEGMENT_SIZE, true);
+
+    addTier(1000, "1s");
+    addTier(60 * 1000, "1min");
+    addTier(60 * 60 * 1000, "1h");
+
+    connect(m_ticker, &EscTicker::timeout, this,
             [=](){
-        for (const WingSlot& unit : m_units) {
-            m_log.setValue("SerialNo", unit.id());
-            m_log.setValue("InputCurrent", unit.stats().iSupply);
-            m_log.setValue("OutputCurrent", unit.stats().iSupplyWing);
-            m_log.setValue("SlotLoss", unit.stats().loss);
-            m_log.setValue("Temperature", unit.stats().temperature);
-            m_log.setValue("Charging", unit.isCharging());
-            m_log.setValue("Pairing", unit.isPaired());
-            if (unit.isPaired()) {
-                m_log.setValue("WingSerial", unit.stats().wing.serial);
-                m_log.setValue("SlotLQI", unit.stats().LQI);
-                m_log.setValue("WingLQI", unit.stats().wing.LQI);
-                m_log.setValue("WingLoss", unit.stats().wing.loss);
-                m_log.setValue("WingTemperature", unit.stats().wing.temperature);
-            }
-            m_log.save();
+        if (m_mode == Mode::HIGH_RATE) {
+            closeTiers(false);
+            ageRaw();
+            return;
         }
+        snapshot();
     });
 }
 
+EscRecorder::~EscRecorder()
+{
+    stop();
+}
+
 void EscRecorder::setPath(const QString &path)
 {
     m_log.setPath(path);
+    m_raw.setPath(path);
+    for (auto& tier: m_tiers) {
+        tier.log->setPath(path);
+    }
+}
+
+void EscRecorder::setFormat(const PALM::Format format)
+{
+    m_log.setFormat(format);
+    m_raw.setFormat(format);
+    for (auto& tier: m_tiers) {
+        tier.log->setFormat(format);
+    }
+}
+
+void EscRecorder::setMode(const EscRecorder::Mode mode)
+{
+    m_mode = mode;
+}
+
+void EscRecorder::setRawRetention(const int days)
+{
+    m_rawRetention = days;
 }
 
 void EscRecorder::start(int interval)
@@ -50,10 +94,180 @@ void EscRecorder::start(int interval)
 //    for (WingSlot& unit : m_units) {
 //        unit.setSampling((int)(interval/SAMPLES_PER_PERIOD));
 //    }
-    m_ticker.start(interval);
+    if (m_mode == Mode::HIGH_RATE) {
+        for (WingSlot& unit : m_units) {
+            m_sampling.push_back(connect(&unit, &WingSlot::new_data, this,
+                                         [=, &unit](const WingSlot::Stats &stats){
+                sample({unit.id(), stats, unit.isCharging(), unit.isPaired()});
+            }));
+        }
+        ageRaw();
+        interval = TIER_TICK;
+    }
+    m_ticker->start(interval);
 }
 
 void EscRecorder::stop()
 {
-    m_ticker.stop();
+    m_ticker->stop();
+    for (const auto& connection: m_sampling) {
+        disconnect(connection);
+    }
+    m_sampling.clear();
+    closeTiers(true);
+    m_log.flush();
+    m_raw.flush();
+}
+
+void EscRecorder::addColumns(PALM &log)
+{
+    log.addColumn("InputCurrent");
+    log.addColumn("OutputCurrent");
+    log.addColumn("SlotLoss");
+    log.addColumn("Temperature");
+    log.addColumn("Charging"); // -Age ? Period? Succession? Duration?
+    log.addColumn("Pairing"); // -Age ?
+    log.addColumn("WingSerial");
+    log.addColumn("SlotLQI");
+    log.addColumn("WingLQI");
+    log.addColumn("WingLoss");
+    log.addColumn("WingTemperature");
+}
+
+void EscRecorder::addTier(const qint64 period, const QString &suffix)
+{
+    Tier tier = {EscDownsampler(period, TIER_FIELDS.size()), std::unique_ptr<PALM>(new PALM(TITLE + "_" + suffix)), 0, 0, 0, {}};
+    auto &log = *tier.log;
+    log.addColumn("BucketStart");
+    log.addColumn("Samples");
+    for (const auto& field: TIER_FIELDS) {
+        log.addColumn(field + "Min");
+        log.addColumn(field + "Mean");
+        log.addColumn(field + "Max");
+        tier.columns.push_back(log.column(field + "Min"));
+        tier.columns.push_back(log.column(field + "Mean"));
+        tier.columns.push_back(log.column(field + "Max"));
+    }
+    tier.serialNo = log.column("SerialNo");
+    tier.start = log.column("BucketStart");
+    tier.samples = log.column("Samples");
+    log.setFlushPolicy(PALM::Flush::INTERVAL, TIER_TICK);
+    log.setRotation(SEGMENT_SIZE, true);
+    m_tiers.push_back(std::move(tier));
+}
+
+void EscRecorder::snapshot()
+{
+    // Every unit is read at the tick instant before anything is formatted or written
+    m_snapshot.clear();
+    for (const WingSlot& unit : m_units) {
+        m_snapshot.push_back({unit.id(), unit.stats(), unit.isCharging(), unit.isPaired()});
+    }
+    m_log.beginBatch();
+    for (const auto& unit: m_snapshot) {
+        write(m_log, unit);
+        m_log.save();
+    }
+    m_log.commitBatch();
+}
+
+void EscRecorder::write(PALM &log, const EscRecorder::Snapshot &unit)
+{
+    const auto &stats = unit.stats;
+    log.setValue(m_column.serialNo, unit.id);
+    log.setValue(m_column.inputCurrent, stats.iSupply);
+    log.setValue(m_column.outputCurrent, stats.iSupplyWing);
+    log.setValue(m_column.slotLoss, stats.loss);
+    log.setValue(m_column.temperature, stats.temperature);
+    log.setValue(m_column.charging, unit.charging);
+    log.setValue(m_column.pairing, unit.paired);
+    if (unit.paired) {
+        log.setValue(m_column.wingSerial, stats.wing.serial);
+        log.setValue(m_column.slotLQI, stats.LQI);
+        log.setValue(m_column.wingLQI, stats.wing.LQI);
+        log.setValue(m_column.wingLoss, stats.wing.loss);
+        log.setValue(m_column.wingTemperature, stats.wing.temperature);
+    }
+}
+
+void EscRecorder::sample(const EscRecorder::Snapshot &unit)
+{
+    write(m_raw, unit);
+    m_raw.save();
+
+    const auto &stats = unit.stats;
+    const auto none = std::numeric_limits<double>::quiet_NaN();
+    const auto wing = unit.paired && stats.wing.dataPresent;
+    const std::vector<double> values = {
+        stats.iSupply,
+        stats.iSupplyWing,
+        stats.loss,
+        stats.temperature,
+        wing ? stats.wing.loss : none,
+        wing ? stats.wing.temperature : none,
+        wing ? stats.wing.batCurrent : none,
+    };
+    const auto now = EscClock::instance().now();
+    std::vector<EscDownsampler::Bucket> done;
+    for (auto& tier: m_tiers) {
+        tier.sampler.add(unit.id, now, values, done);
+        writeTier(tier, done);
+        done.clear();
+    }
+}
+
+void EscRecorder::writeTier(EscRecorder::Tier &tier, const std::vector<EscDownsampler::Bucket> &buckets)
+{
+    auto &log = *tier.log;
+    for (const auto& bucket: buckets) {
+        log.setValue(tier.serialNo, bucket.unit);
+        log.setValue(tier.start, QVariant(QDateTime::fromMSecsSinceEpoch(bucket.start)));
+        log.setValue(tier.samples, bucket.samples);
+        for (std::size_t i = 0; i < bucket.fields.size(); ++i) {
+            const auto &field = bucket.fields[i];
+            if (field.count > 0) {
+                log.setValue(tier.columns[3 * i], field.min);
+                log.setValue(tier.columns[3 * i + 1], field.mean());
+                log.setValue(tier.columns[3 * i + 2], field.max);
+            }
+        }
+        log.save();
+    }
+}
+
+void EscRecorder::closeTiers(const bool all)
+{
+    const auto now = EscClock::instance().now();
+    std::vector<EscDownsampler::Bucket> done;
+    for (auto& tier: m_tiers) {
+        if (all) {
+            tier.sampler.drain(done);
+        } else {
+            tier.sampler.expire(now, done);
+        }
+        writeTier(tier, done);
+        done.clear();
+        if (all) {
+            tier.log->flush();
+        }
+    }
+}
+
+void EscRecorder::ageRaw()
+{
+    auto today = QDate::currentDate();
+    if (m_rawRetention <= 0 || m_aged == today) {
+        return;
+    }
+    m_aged = today;
+
+    // Daily raw logs and their sealed segments, named <title>_yyyy_MM_dd...
+    QDir dir(m_raw.path());
+    const auto oldest = today.addDays(-m_rawRetention);
+    for (const auto& name: dir.entryList(QStringList() << RAW_TITLE + "_*", QDir::Files)) {
+        auto date = QDate::fromString(name.mid(RAW_TITLE.size() + 1, 10), "yyyy_MM_dd");
+        if (date.isValid() && date < oldest) {
+            dir.remove(name);
+        }
+    }
 }
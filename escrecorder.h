@@ -2,7 +2,9 @@
 #define ESCRECORDER_H
 
 #include <QObject>
-#include <QTimer>
+#include <memory>
+#include "escclock.h"
+#include "escdownsampler.h"
 #include "wingslot.h"
 #include "palm.h"
 
@@ -11,17 +13,87 @@ class EscRecorder : public QObject
 {
     Q_OBJECT
 public:
+    enum class Mode {
+        SNAPSHOT,                           // One row per unit every interval
+        HIGH_RATE,                          // Every sample to the raw log, plus min/mean/max tiers
+    };
+
     explicit EscRecorder(WingSlot::SlotList units, QObject *parent = nullptr);
+    // Stops, so the open tier buckets are written rather than dropped
+    ~EscRecorder();
     void setPath(const QString &path);
+    void setFormat(const PALM::Format format);
+    void setMode(const Mode mode);
+    // Raw logs older than this many days are removed, the tiers are kept
+    void setRawRetention(const int days);
     void start(int interval);
     void stop();
 
+protected:
+    struct Snapshot {
+        int id;
+        WingSlot::Stats stats;
+        bool charging;
+        bool paired;
+    };
+    struct Tier {
+        EscDownsampler sampler;
+        std::unique_ptr<PALM> log;
+        PALM::Column serialNo;
+        PALM::Column start;
+        PALM::Column samples;
+        std::vector<PALM::Column> columns;  // Min, mean and max of every field
+    };
+    void addColumns(PALM &log);
+    void addTier(const qint64 period, const QString &suffix);
+    void snapshot();
+    void write(PALM &log, const Snapshot &unit);
+    void sample(const Snapshot &unit);
+    void writeTier(Tier &tier, const std::vector<EscDownsampler::Bucket> &buckets);
+    void closeTiers(const bool all);
+    void ageRaw();
+
 private:
     WingSlot::SlotList m_units;
     PALM m_log;
-    QTimer m_ticker;
+    PALM m_raw;
+    std::vector<Tier> m_tiers;
+    std::vector<Snapshot> m_snapshot;
+    std::vector<QMetaObject::Connection> m_sampling;
+    EscTicker *m_ticker;
+    Mode m_mode;
+    int m_rawRetention;
+    QDate m_aged;
+    struct {
+        PALM::Column serialNo;
+        PALM::Column inputCurrent;
+        PALM::Column outputCurrent;
+        PALM::Column slotLoss;
+        PALM::Column temperature;
+        PALM::Column charging;
+        PALM::Column pairing;
+        PALM::Column wingSerial;
+        PALM::Column slotLQI;
+        PALM::Column wingLQI;
+        PALM::Column wingLoss;
+        PALM::Column wingTemperature;
+    } m_column;
 
     const int SAMPLES_PER_PERIOD = 1;
+    const qint64 SEGMENT_SIZE = 64 * 1024 * 1024;      // [Bytes]
+    const QString TITLE = "eB_WST_002_log";
+    const QString RAW_TITLE = "eB_WST_002_raw";
+    const int TIER_TICK = 1000;                         // [Milliseconds] Closes buckets of silent units
+    const int DEFAULT_RAW_RETENTION = 7;                // [Days]
+    const std::vector<QString> TIER_FIELDS = {
+        "InputCurrent",
+        "OutputCurrent",
+        "SlotLoss",
+        "Temperature",
+        "WingLoss",
+        "WingTemperature",
+        "WingBatCurrent",
+    };
 };
 
 #endif // ESCRECORDER_H
@@ -0,0 +1,225 @@
+#include "escsimulator.h"
+#include "escrecorder.h"
+#include "escclock.h"
+#include <QElapsedTimer>
+#include <QDir>
+#include <cmath>
+
+SimulatedSlot::SimulatedSlot(int id, const SimulatedSlot::Profile &profile, unsigned seed)
+    : WingSlot(id, 0)
+    , m_profile(profile)
+    , m_powered(false)
+    , m_switched(EscClock::instance().now())
+    , m_pairedAt(-1)
+    , m_from(profile.iPassive)
+    , m_random(seed)
+    , m_noise(0.0, 1.0)
+{
+    setFirmware(QString("Simulated 0.0.0"));
+}
+
+const SimulatedSlot::Profile &SimulatedSlot::profile() const
+{
+    return m_profile;
+}
+
+bool SimulatedSlot::setCharge(bool enable)
+{
+    auto now = EscClock::instance().now();
+    if (enable != m_powered) {
+        m_from = supplyCurrent(now);
+        m_switched = now;
+        m_powered = enable;
+        if (!enable) {
+            m_pairedAt = -1;
+        }
+    }
+    return processResponse(true);
+}
+
+bool SimulatedSlot::getData(SmartCageData1 &data)
+{
+    auto now = EscClock::instance().now();
+    auto paired = m_powered && m_pairedAt >= 0 && now >= m_pairedAt;
+    auto current = supplyCurrent(now);
+    current += m_noise(m_random) * current * 0.01;
+
+    data.iSupply = current;
+    data.iSupplyWing = current * (m_powered ? 0.9 : 0.4);
+    data.SlotLqi = 95;
+    data.Temperature = 25;
+    data.flags.bPowerEnable = m_powered;
+    data.DataAge = 0;
+    data.flags.bWingDataPresent = paired;
+    data.WingLoss = 0;
+    data.WingLqi = 90;
+    data.WingSerial = 100000 + id();
+    data.WingHumidity = 30;
+    data.WingTemperature = 25;
+    data.WingBatCapacity = 80;
+    data.WingBatVolt = 4.0;
+    data.WingBatCurrent = m_profile.batCurrent;
+    data.iReturnWing = 0;
+    data.vReturnWing = 0;
+    return processResponse(true);
+}
+
+bool SimulatedSlot::setWingSampling(float /*interval*/)
+{
+    return processResponse(true);
+}
+
+bool SimulatedSlot::startPairing()
+{
+    if (m_powered && m_pairedAt < 0 && m_profile.pairingDelay >= 0) {
+        m_pairedAt = EscClock::instance().now() + m_profile.pairingDelay;
+    }
+    return processResponse(true);
+}
+
+double SimulatedSlot::supplyCurrent(const qint64 now)
+{
+    auto target = m_powered ? m_profile.iActive : m_profile.iPassive;
+    return target + (m_from - target) * std::exp(-(now - m_switched) / m_profile.settleTime);
+}
+
+EscSimulator::EscSimulator(QObject *parent)
+    : QObject(parent)
+    , m_path(QDir::tempPath())
+    , m_seed(1)
+{
+
+}
+
+void EscSimulator::setPath(const QString &path)
+{
+    m_path = path;
+}
+
+void EscSimulator::setSeed(const unsigned seed)
+{
+    m_seed = seed;
+}
+
+EscSimulator::Result EscSimulator::runTests(const int units, const TestScheduler::Capacity &capacity)
+{
+    Result result = {units, 0, 0, 0, 0};
+    QElapsedTimer wallWatch;
+    wallWatch.start();
+
+    VirtualClock clock;
+    EscClock::setInstance(&clock);
+    const auto limits = EscFuncTest::getLimits();
+    const auto durations = EscFuncTest::getDuration();
+    const auto plan = EscFuncTest::plan();
+    EscFuncTest::setLimits({8, 4, 180, 180, 48, 1, 0, 0, 1});
+    EscFuncTest::setDuration({15000, 30000, 30000});
+    auto simulationPlan = plan;
+    simulationPlan.setPath(m_path);
+    QString message;
+    EscFuncTest::setPlan(simulationPlan, message);
+
+    {
+        auto simulated = makeUnits(units);
+        TestScheduler scheduler;
+        scheduler.setCapacity(capacity);
+        bool done = false;
+        int completed = 0;
+        connect(&scheduler, &TestScheduler::finished, this,
+                [&](WingSlot *unit, const EscFuncTest::State &state, const bool &passed, const QString &){
+            if (state != EscFuncTest::State::DONE) {
+                return;
+            }
+            ++completed;
+            if (passed) {
+                ++result.approved;
+            }
+            if (passed != static_cast<SimulatedSlot*>(unit)->profile().approved) {
+                ++result.mismatches;
+            }
+        });
+        connect(&scheduler, &TestScheduler::completed, this,
+                [&](const int, const int){
+            done = true;
+        });
+
+        for (auto& slot: simulated) {
+            scheduler.enqueue(*slot);
+        }
+        scheduler.start(TESTING_INTERVAL);
+        if (!clock.runUntil([&](){ return done; }, TEST_TIMEOUT)) {
+            // Units still under test when time ran out have no verdict to compare
+            result.mismatches += units - completed;
+        }
+        result.virtualTime = clock.now();
+        scheduler.stop();
+    }
+
+    EscFuncTest::setPlan(plan, message);
+    EscFuncTest::setDuration(durations);
+    EscFuncTest::setLimits(limits);
+    EscClock::setInstance(nullptr);
+    result.wallTime = wallWatch.elapsed();
+    return result;
+}
+
+EscSimulator::Result EscSimulator::runRecorder(const int units, const int duration)
+{
+    Result result = {units, 0, 0, 0, 0};
+    QElapsedTimer wallWatch;
+    wallWatch.start();
+
+    VirtualClock clock;
+    EscClock::setInstance(&clock);
+    {
+        auto simulated = makeUnits(units);
+        WingSlot::SlotList list;
+        for (auto& slot: simulated) {
+            list.push_back(std::ref(static_cast<WingSlot&>(*slot)));
+        }
+        EscRecorder recorder(list);
+        recorder.setPath(m_path);
+        recorder.start(RECORDING_INTERVAL);
+        clock.advance(duration);
+        recorder.stop();
+        result.virtualTime = clock.now();
+    }
+    EscClock::setInstance(nullptr);
+    result.wallTime = wallWatch.elapsed();
+    return result;
+}
+
+std::vector<std::unique_ptr<SimulatedSlot>> EscSimulator::makeUnits(const int units)
+{
+    std::vector<std::unique_ptr<SimulatedSlot>> simulated;
+    for (int i = 0; i < units; ++i) {
+        std::unique_ptr<SimulatedSlot> slot(new SimulatedSlot(i + 1, makeProfile(i), m_seed + i));
+        slot->setSampling(SAMPLING_INTERVAL);
+        simulated.push_back(std::move(slot));
+    }
+    return simulated;
+}
+
+SimulatedSlot::Profile EscSimulator::makeProfile(const int index)
+{
+    SimulatedSlot::Profile profile = {5.0, 150.0, 300.0 + (index % 7) * 200.0, 1000 + (index % 5) * 1500, 50.0f, true};
+    if (index % FAULT_RATE != FAULT_RATE - 1) {
+        return profile;
+    }
+    profile.approved = false;
+    switch ((index / FAULT_RATE) % 4) {
+    case 0 :
+        profile.iPassive = 12.0;
+        break;
+    case 1 :
+        profile.pairingDelay = -1;
+        break;
+    case 2 :
+        profile.batCurrent = 30.0f;
+        break;
+    case 3 :
+        profile.iActive = 200.0;
+        break;
+    }
+    return profile;
+}
@@ -0,0 +1,75 @@
+#ifndef ESCSIMULATOR_H
+#define ESCSIMULATOR_H
+
+#include <QObject>
+#include <random>
+#include <memory>
+#include "wingslot.h"
+#include "testscheduler.h"
+
+class SimulatedSlot : public WingSlot
+{
+public:
+    struct Profile {
+        double iPassive;                    // [mA]
+        double iActive;                     // [mA]
+        double settleTime;                  // [Milliseconds] Time constant of the supply current
+        int pairingDelay;                   // [Milliseconds] Negative never pairs
+        float batCurrent;                   // [mA]
+        bool approved;                      // Expected verdict
+    };
+
+    SimulatedSlot(int id, const Profile &profile, unsigned seed);
+    const Profile &profile() const;
+    bool setCharge(bool enable) override;
+
+protected:
+    bool getData(SmartCageData1 &data) override;
+    bool setWingSampling(float interval) override;
+    bool startPairing() override;
+    double supplyCurrent(const qint64 now);
+
+private:
+    Profile m_profile;
+    bool m_powered;
+    qint64 m_switched;
+    qint64 m_pairedAt;
+    double m_from;
+    std::mt19937 m_random;
+    std::normal_distribution<double> m_noise;
+};
+
+class EscSimulator : public QObject
+{
+    Q_OBJECT
+public:
+    struct Result {
+        int units;
+        int approved;
+        int mismatches;                     // Verdicts that differ from the simulated profile
+        qint64 virtualTime;                 // [Milliseconds]
+        qint64 wallTime;                    // [Milliseconds]
+    };
+
+    explicit EscSimulator(QObject *parent = nullptr);
+    void setPath(const QString &path);
+    void setSeed(const unsigned seed);
+    Result runTests(const int units, const TestScheduler::Capacity &capacity);
+    Result runRecorder(const int units, const int duration);
+
+protected:
+    std::vector<std::unique_ptr<SimulatedSlot>> makeUnits(const int units);
+    SimulatedSlot::Profile makeProfile(const int index);
+
+private:
+    QString m_path;
+    unsigned m_seed;
+
+    static const int SAMPLING_INTERVAL = 200;           // [Milliseconds]
+    static const int TESTING_INTERVAL = 1000;           // [Milliseconds]
+    static const int RECORDING_INTERVAL = 60000;        // [Milliseconds]
+    static const int TEST_TIMEOUT = 3600000;            // [Milliseconds] Virtual time per batch
+    static const int FAULT_RATE = 5;                    // Every n-th unit carries a fault
+};
+
+#endif // ESCSIMULATOR_H
@@ -1,14 +1,268 @@
 #include "mainwindow.h"
 #include <QApplication>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <algorithm>
 
 #include "palm.h"
+#include "palmcolumns.h"
+#include "palmwriter.h"
+#include "palmarchive.h"
+#include "palmindex.h"
+#include "palmreader.h"
+#include "escsimulator.h"
+#include "GraphWidget/graphrenderer.h"
+
+// Runs the test engine against simulated slots in virtual time
+int simulate(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QTextStream out(stdout);
+    auto units = (argc > 2) ? QString(argv[2]).toInt() : 8;
+    auto runs = (argc > 3) ? QString(argv[3]).toInt() : 1;
+    auto parallel = (argc > 4) ? QString(argv[4]).toInt() : 8;
+
+    TestPlan plan;
+    QString message;
+    if (!plan.load(TestPlan::BUILTIN) || !EscFuncTest::setPlan(plan, message)) {
+        out << plan.errorString() << message << "\n";
+        return 1;
+    }
+
+    QTemporaryDir logs;
+    EscSimulator simulator;
+    simulator.setPath(logs.path());
+
+    int mismatches = 0;
+    qint64 virtualTime = 0;
+    qint64 wallTime = 0;
+    for (int run = 0; run < runs; ++run) {
+        simulator.setSeed(run + 1);
+        auto result = simulator.runTests(units, {parallel, 1, parallel / 2 + 1});
+        mismatches += result.mismatches;
+        virtualTime += result.virtualTime;
+        wallTime += result.wallTime;
+        out << QString("Run %1: %2 units, %3 approved, %4 mismatches, %5 s virtual, %6 ms wall")
+               .arg(run + 1)
+               .arg(result.units)
+               .arg(result.approved)
+               .arg(result.mismatches)
+               .arg(result.virtualTime / 1000)
+               .arg(result.wallTime) << "\n";
+    }
+    out << QString("%1 runs: %2 units/hour, %3 mismatches, %4 ms wall")
+           .arg(runs)
+           .arg(QString::number(units * runs * 3600000.0 / std::max<qint64>(virtualTime, 1), 'f', 1))
+           .arg(mismatches)
+           .arg(wallTime) << "\n";
+    PalmWriter::instance().stop();
+    return (mismatches == 0) ? 0 : 1;
+}
+
+// Converts a columnar PALM log back to the text layout read by the PALM importer
+int exportText(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QTextStream err(stderr);
+    if (argc < 3) {
+        err << "Usage: esctest --export <log" << PalmColumns::SUFFIX << "> [output.txt]\n";
+        return 1;
+    }
+
+    PalmColumnReader reader;
+    if (!reader.open(QString(argv[2]))) {
+        err << reader.errorString() << "\n";
+        return 1;
+    }
+    QFile file;
+    if (argc > 3) {
+        file.setFileName(QString(argv[3]));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            err << file.errorString() << "\n";
+            return 1;
+        }
+    } else {
+        file.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+    }
+    QTextStream out(&file);
+    if (!reader.exportText(out)) {
+        err << reader.errorString() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+// Prints a day of text log, sealed and compressed segments included
+int catLog(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QTextStream err(stderr);
+    if (argc < 3) {
+        err << "Usage: esctest --cat <daily log.txt>\n";
+        return 1;
+    }
+
+    PalmArchive archive;
+    if (!archive.open(QString(argv[2]))) {
+        err << archive.errorString() << "\n";
+        return 1;
+    }
+    QFile out;
+    out.open(stdout, QIODevice::WriteOnly);
+    QByteArray line;
+    while (archive.readLine(line)) {
+        out.write(line);
+    }
+    if (!archive.errorString().isEmpty()) {
+        err << archive.errorString() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+// Indexes the rows of a log directory that were written before indexing was on
+int buildIndex(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QTextStream out(stdout);
+    if (argc < 3) {
+        out << "Usage: esctest --index <log directory>\n";
+        return 1;
+    }
+
+    PalmIndex index(QString(argv[2]));
+    if (!index.open()) {
+        out << index.errorString() << "\n";
+        return 1;
+    }
+    QStringList report;
+    auto rows = index.build(report);
+    for (const auto& line: report) {
+        out << line << "\n";
+    }
+    out << QString("%1 rows indexed").arg(rows) << "\n";
+    return 0;
+}
+
+// Looks up logged rows by unit, wing, firmware, verdict and time
+int queryIndex(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QTextStream err(stderr);
+    if (argc < 3) {
+        err << "Usage: esctest --query <log directory> [--serial N] [--wing N] [--firmware S]"
+               " [--approved 0|1] [--from ISO] [--to ISO]\n";
+        return 1;
+    }
+
+    PalmIndex::Query query;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        auto option = QString(argv[i]);
+        auto value = QString(argv[i + 1]);
+        if (option == "--serial") {
+            query.serial = value.toInt();
+        } else if (option == "--wing") {
+            query.wingSerial = value.toInt();
+        } else if (option == "--firmware") {
+            query.firmware = value;
+        } else if (option == "--approved") {
+            query.approved = value.toInt();
+        } else if (option == "--from") {
+            query.from = QDateTime::fromString(value, Qt::ISODate).toMSecsSinceEpoch();
+        } else if (option == "--to") {
+            query.to = QDateTime::fromString(value, Qt::ISODate).toMSecsSinceEpoch();
+        } else {
+            err << "Unknown option " << option << "\n";
+            return 1;
+        }
+    }
+
+    PalmIndex index(QString(argv[2]));
+    if (!index.open()) {
+        err << index.errorString() << "\n";
+        return 1;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    auto matches = index.query(query);
+    auto elapsed = timer.elapsed();
+
+    QFile out;
+    out.open(stdout, QIODevice::WriteOnly);
+    QByteArray row;
+    for (const auto& match: matches) {
+        out.write(QString("%1:%2: ").arg(match.file).arg(match.entry.offset).toUtf8());
+        out.write(PalmIndex::readRow(match.file, match.entry.offset, row) ? row : QByteArray("<missing>\n"));
+    }
+    err << QString("%1 rows matched in %2 ms").arg(matches.size()).arg(elapsed) << "\n";
+    return 0;
+}
+
+// Yield report over text logs: per-day throughput and failure rate, per-unit means
+int report(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QTextStream err(stderr);
+    if (argc < 3) {
+        err << "Usage: esctest --report [--threads N] <log directory or file>...\n";
+        return 1;
+    }
+
+    PalmReader reader;
+    QStringList paths;
+    for (int i = 2; i < argc; ++i) {
+        if (QString(argv[i]) == "--threads" && i + 1 < argc) {
+            reader.setThreads(QString(argv[++i]).toInt());
+        } else {
+            paths << QString(argv[i]);
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    auto ok = reader.read(paths);
+    for (const auto& message: reader.errors()) {
+        err << message << "\n";
+    }
+    QTextStream out(stdout);
+    reader.writeReport(out);
+    err << QString("Read in %1 ms").arg(timer.elapsed()) << "\n";
+    return ok ? 0 : 1;
+}
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
-    MainWindow w;
-    w.setWindowIcon(QIcon(":/icons/wingslot_icon.png"));
-    w.show();
+    if (argc > 1 && QString(argv[1]) == "--simulate") {
+        return simulate(argc, argv);
+    }
+    if (argc > 1 && QString(argv[1]) == "--export") {
+        return exportText(argc, argv);
+    }
+    if (argc > 1 && QString(argv[1]) == "--cat") {
+        return catLog(argc, argv);
+    }
+    if (argc > 1 && QString(argv[1]) == "--index") {
+        return buildIndex(argc, argv);
+    }
+    if (argc > 1 && QString(argv[1]) == "--query") {
+        return queryIndex(argc, argv);
+    }
+    if (argc > 1 && QString(argv[1]) == "--report") {
+        return report(argc, argv);
+    }
 
-    return a.exec();
+    QApplication a(argc, argv);
+    int status;
+    {
+        MainWindow w;
+        w.setWindowIcon(QIcon(":/icons/wingslot_icon.png"));
+        w.show();
+        status = a.exec();
+    }
+    // The window's logs submit their last rows as they are destroyed, stop the writer after them
+    PalmWriter::instance().stop();
+    GraphRenderer::instance().stop();
+    return status;
 }
@@ -4,15 +4,24 @@
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QSettings>
+#include <QDir>
 #include <QRegExp>
 #include <QToolTip>
 #include <QDebug>
+#include <algorithm>
+#include "palmwriter.h"
+#include "palmwal.h"
+#include "GraphWidget/graphframeclock.h"
 
 MainWindow::MainWindow(QWidget *parent)
     : ToolFrame(parent)
     , m_toggleButton(new QPushButton(this))
 {
     setWindowTitle("eBird WCB Manager");
+    QSettings settings("Seatex", "WingSlotTest");
+    if (settings.contains(QString("graph_frame_rate"))) {
+        GraphFrameClock::instance().setMaxFrameRate(settings.value(QString("graph_frame_rate")).toInt());
+    }
     useEventlog();
     putContent(makeContent());
     putSettings(makeSettings());
@@ -27,32 +36,50 @@ MainWindow::MainWindow(QWidget *parent)
     m_recordPanel.setEnabled(false);
     m_testPanel.setEnabled(false);
 
-    output() << QString("Test version %1").arg(EscFuncTest::VERSION);
-}
+    connectScheduler();
+    loadTestPlan();
 
+    connect(&PalmWriter::instance(), &PalmWriter::congested, this,
+            [=](const quint64 waits, const quint64 drops){
+        output() << QString("Log writer is falling behind; %1 waits, %2 rows dropped").arg(waits).arg(drops);
+    });
+    connect(&PalmWriter::instance(), &PalmWriter::error, this,
+            [=](const QString &message){
+        error();
+        output() << message;
+    });
+    connect(&PalmWriter::instance(), &PalmWriter::recovered, this,
+            [=](const QString &report){
+        output() << QString("Recovered log %1").arg(report);
+    });
 
-void MainWindow::startTest()
-{
-    if (m_test_queue.size() < 1) {
-        return;
-    }
-    resetTest();
-    if (m_test != nullptr) {
-        delete m_test;
+    QStringList reports;
+    PalmWal::recoverDirectory(QDir::homePath() + RECORDER_PATH, reports);
+    for (const auto& report: reports) {
+        output() << report;
     }
+}
 
-    auto test_unit = m_test_queue.front();
-    m_test_queue.pop();
-    m_test = new EscFuncTest(*test_unit, this);
-    if (false) { // TODO: give user a looping option
-        m_test_queue.push(test_unit);
-    }
 
-    const bool isMutable = false;
-    m_unitBrowser.display(test_unit, isMutable);
+void MainWindow::connectScheduler()
+{
+    m_scheduler.setJournal(QDir::homePath() + TEST_JOURNAL);
+
+    connect(&m_scheduler, &TestScheduler::admitted, this,
+            [=](WingSlot *unit){
+        if (m_testFocus == nullptr) {
+            focusTest(unit);
+        }
+    });
 
-    connect(m_test, &EscFuncTest::finished, this,
-            [=](const EscFuncTest::State &state, const bool &passed, const QString &message){
+    connect(&m_scheduler, &TestScheduler::finished, this,
+            [=](WingSlot *unit, const EscFuncTest::State &state, const bool &passed, const QString &message){
+        if (!message.isEmpty()) {
+            output() << message;
+        }
+        if (unit != m_testFocus) {
+            return;
+        }
         switch (state) {
         case EscFuncTest::State::NONE :
             output() << QString("Test finished state: NONE");
@@ -88,30 +115,56 @@ void MainWindow::startTest()
 
         case EscFuncTest::State::DONE :
             m_progressBar.setValue(100);
-            if (!m_test_queue.empty()) {
+            m_testFocus = nullptr;
+            if (m_scheduler.isRunning()) {
                 QTimer::singleShot(TESTING_DELAY, this, [=](){
-                    startTest();
+                    if (m_testFocus == nullptr && m_scheduler.isRunning()) {
+                        focusTest(m_scheduler.units().front());
+                    }
                 });
-            } else {
-                m_testButton.setState("Test");
-                m_busScanner.setEnabled(true);
-                m_unitEditor.setEnabled(true);
-                started();
             }
             break;
         }
-        if (!message.isEmpty()) {
-            output() << message;
-        }
     });
 
-    connect(m_test, &EscFuncTest::error, this,
+    connect(&m_scheduler, &TestScheduler::completed, this,
+            [=](const int units, const int elapsed){
+        output() << QString("Tested %1 units in %2 s (%3 units/hour)")
+                    .arg(units)
+                    .arg(elapsed / 1000)
+                    .arg(QString::number(units * 3600000.0 / std::max(elapsed, 1), 'f', 1));
+        m_testButton.setState("Test");
+        m_busScanner.setEnabled(true);
+        m_unitEditor.setEnabled(true);
+        started();
+    });
+
+    connect(&m_scheduler, &TestScheduler::error, this,
             [=](const QString &message){
         error();
         output() << message;
     });
+}
+
+void MainWindow::resumeTest()
+{
+    auto resumed = m_scheduler.resume(m_units);
+    if (resumed == 0) {
+        return;
+    }
+    output() << QString("Resuming %1 units from the test journal").arg(resumed);
+    m_testButton.setState("Stop");
+    m_scheduler.start(TESTING_INTERVAL);
+    m_busScanner.setEnabled(false);
+    running();
+}
 
-    m_test->start(TESTING_INTERVAL);
+void MainWindow::focusTest(WingSlot *unit)
+{
+    resetTest();
+    m_testFocus = unit;
+    const bool isMutable = false;
+    m_unitBrowser.display(unit, isMutable);
     m_progressBar.glideTo(100, EscFuncTest::getDuration().passive);
 }
 
@@ -158,6 +211,7 @@ QWidget *MainWindow::makeBusScanner()
         m_toggleButton->setText(QString("%0 units").arg(m_units.size()));
         m_unitEditor.setEnabled(!m_units.empty());
         m_testPanel.setEnabled(!m_units.empty());
+        resumeTest();
     });
 
     auto layout = new QFormLayout(&m_busScanner);
@@ -174,7 +228,7 @@ QWidget *MainWindow::makeUnitViewer()
 
     connect(&m_unitViewer, &QCheckView::selected, this,
             [=](const int id){
-        if (m_test != nullptr && m_test->isRunning()) {
+        if (m_scheduler.isRunning()) {
             return;
         }
         auto unit = std::find_if(m_units.begin(), m_units.end(),
@@ -232,7 +286,17 @@ QWidget *MainWindow::makeRecordPanel()
         } while (it != m_units.end());
 
         m_recorder = new EscRecorder(units, this);
-        m_recorder->setPath("~/PALM/log");
+        m_recorder->setPath("~" + RECORDER_PATH);
+        QSettings settings("Seatex", "WingSlotTest");
+        if (settings.value(QString("recorder_format")).toString() == "columnar") {
+            m_recorder->setFormat(PALM::Format::COLUMNAR);
+        }
+        if (settings.value(QString("recorder_mode")).toString() == "high_rate") {
+            m_recorder->setMode(EscRecorder::Mode::HIGH_RATE);
+            if (settings.contains(QString("recorder_raw_days"))) {
+                m_recorder->setRawRetention(settings.value(QString("recorder_raw_days")).toInt());
+            }
+        }
         m_recorder->start(RECORDING_INTERVAL);
     });
 
@@ -298,6 +362,7 @@ QWidget *MainWindow::makeTestPanel()
             [=](const QString &state){
         if (QString::compare(state, "Test") == 0) {
             auto selection = m_unitViewer.checkedItems();
+            int queued = 0;
             auto it = m_units.begin();
             do {
                 it = std::find_if(it, m_units.end(), [&](WingSlot::Unit &u){
@@ -310,22 +375,23 @@ QWidget *MainWindow::makeTestPanel()
                     return match;
                 });
                 if (it != m_units.end()) {
-                    m_test_queue.push(&it->get());
+                    m_scheduler.enqueue(it->get());
+                    ++queued;
                     ++it;
                 }
             } while (it != m_units.end());
 
-            if (m_test_queue.empty()) {
+            if (queued == 0) {
                 auto index = m_unitViewer.currentIndex().row();
-                auto unit = &(index >= 0 ? m_units.at(index) : m_units.front()).get();
-                m_test_queue.push(unit);
+                m_scheduler.enqueue(index >= 0 ? m_units.at(index) : m_units.front());
             }
 
-            startTest();
+            m_scheduler.start(TESTING_INTERVAL);
             m_busScanner.setEnabled(false);
             running();
         } else {
-            m_test->stop();
+            m_scheduler.stop();
+            m_testFocus = nullptr;
             m_progressBar.pause();
             m_busScanner.setEnabled(true);
             m_unitEditor.setEnabled(true);
@@ -350,6 +416,11 @@ QWidget *MainWindow::makeSettings()
     reset_button.setText("Reset");
     connect(&reset_button, &QPushButton::clicked, this,
             [=](){
+        // The reset swaps the test plan, which the running tests still use
+        if (m_scheduler.isRunning()) {
+            QToolTip::showText(reset_button.mapToGlobal(QPoint(0, 0)), QString("Can not reset settings while testing!"));
+            return;
+        }
         output() << QString("Settings reset");
         saveSettings("passive_duration", TEST_DEFAULT_PASSIVE_DURATION);
         passive_duration_edit.setText(QString::number(TEST_DEFAULT_PASSIVE_DURATION));
@@ -381,7 +452,20 @@ QWidget *MainWindow::makeSettings()
         saveSettings("packetLoss_edit", packetLoss_value);
         packetLoss_edit.setText(QString::number(packetLoss_value));
 
+        saveSettings("parallel_units", TEST_DEFAULT_PARALLEL_UNITS);
+        parallel_units_edit.setText(QString::number(TEST_DEFAULT_PARALLEL_UNITS));
+
+        saveSettings("charging_units", TEST_DEFAULT_CHARGING_UNITS);
+        charging_units_edit.setText(QString::number(TEST_DEFAULT_CHARGING_UNITS));
+
+        saveSettings("pairing_units", TEST_DEFAULT_PAIRING_UNITS);
+        pairing_units_edit.setText(QString::number(TEST_DEFAULT_PAIRING_UNITS));
+
+        saveSettings("test_plan", TEST_DEFAULT_PLAN);
+        test_plan_edit.setText(TEST_DEFAULT_PLAN);
+
         loadSettings();
+        loadTestPlan();
     });
 
     settings->addRow(tr("&Passive duration"), &passive_duration_edit);
@@ -575,6 +659,80 @@ QWidget *MainWindow::makeSettings()
         saveSettings("packetLoss_edit", number);
         loadSettings();
     });
+    settings->addRow(tr("&Parallel units"), &parallel_units_edit);
+    parallel_units_edit.setPlaceholderText("[units]");
+    connect(&parallel_units_edit, &QLineEdit::returnPressed, this,
+            [=](){
+        auto value = parallel_units_edit.text();
+        if (!isNumber(value)) {
+            QToolTip::showText(parallel_units_edit.mapToGlobal(QPoint(0, 0)), QString("Only digits!"));
+            return;
+        }
+        auto number = value.toDouble();
+        const double MIN_NUMBER = 1.0;
+        const double MAX_NUMBER = 64.0;
+        if (number < MIN_NUMBER || MAX_NUMBER < number) {
+            QToolTip::showText(parallel_units_edit.mapToGlobal(QPoint(0, 0)), QString("This field expects a value between %1 and %2").arg(MIN_NUMBER).arg(MAX_NUMBER));
+            return;
+        }
+        saveSettings("parallel_units", number);
+        loadSettings();
+    });
+    settings->addRow(tr("&Max charging units"), &charging_units_edit);
+    charging_units_edit.setPlaceholderText("[units]");
+    connect(&charging_units_edit, &QLineEdit::returnPressed, this,
+            [=](){
+        auto value = charging_units_edit.text();
+        if (!isNumber(value)) {
+            QToolTip::showText(charging_units_edit.mapToGlobal(QPoint(0, 0)), QString("Only digits!"));
+            return;
+        }
+        auto number = value.toDouble();
+        const double MIN_NUMBER = 1.0;
+        const double MAX_NUMBER = 64.0;
+        if (number < MIN_NUMBER || MAX_NUMBER < number) {
+            QToolTip::showText(charging_units_edit.mapToGlobal(QPoint(0, 0)), QString("This field expects a value between %1 and %2").arg(MIN_NUMBER).arg(MAX_NUMBER));
+            return;
+        }
+        saveSettings("charging_units", number);
+        loadSettings();
+    });
+    settings->addRow(tr("&Max pairing units"), &pairing_units_edit);
+    pairing_units_edit.setPlaceholderText("[units]");
+    connect(&pairing_units_edit, &QLineEdit::returnPressed, this,
+            [=](){
+        auto value = pairing_units_edit.text();
+        if (!isNumber(value)) {
+            QToolTip::showText(pairing_units_edit.mapToGlobal(QPoint(0, 0)), QString("Only digits!"));
+            return;
+        }
+        auto number = value.toDouble();
+        const double MIN_NUMBER = 1.0;
+        const double MAX_NUMBER = 8.0;
+        if (number < MIN_NUMBER || MAX_NUMBER < number) {
+            QToolTip::showText(pairing_units_edit.mapToGlobal(QPoint(0, 0)), QString("This field expects a value between %1 and %2").arg(MIN_NUMBER).arg(MAX_NUMBER));
+            return;
+        }
+        saveSettings("pairing_units", number);
+        loadSettings();
+    });
+    settings->addRow(tr("&Test plan"), &test_plan_edit);
+    test_plan_edit.setPlaceholderText(QString("[file]"));
+    connect(&test_plan_edit, &QLineEdit::returnPressed, this,
+            [=](){
+        if (m_scheduler.isRunning()) {
+            QToolTip::showText(test_plan_edit.mapToGlobal(QPoint(0, 0)), QString("Can not change test plan while testing!"));
+            return;
+        }
+        TestPlan plan;
+        QString message;
+        if (!plan.load(test_plan_edit.text()) || !EscFuncTest::setPlan(plan, message)) {
+            QToolTip::showText(test_plan_edit.mapToGlobal(QPoint(0, 0)), plan.errorString() + message);
+            return;
+        }
+        saveSettings("test_plan", test_plan_edit.text());
+        loadTestPlan();
+    });
 
     auto settings_wrapper = new QWidget(this);
     settings_wrapper->setLayout(settings);
@@ -632,6 +790,44 @@ void MainWindow::loadSettings()
 
     EscFuncTest::setLimits(test_limits);
     EscFuncTest::setDuration(test_durations);
+
+    auto capacity = m_scheduler.capacity();
+
+    auto parallel_units_val = settings.value(QString("parallel_units"), TEST_DEFAULT_PARALLEL_UNITS);
+    parallel_units_edit.setText(parallel_units_val.toString());
+    capacity.units = parallel_units_val.toInt();
+
+    auto charging_units_val = settings.value(QString("charging_units"), TEST_DEFAULT_CHARGING_UNITS);
+    charging_units_edit.setText(charging_units_val.toString());
+    capacity.power = charging_units_val.toInt();
+
+    auto pairing_units_val = settings.value(QString("pairing_units"), TEST_DEFAULT_PAIRING_UNITS);
+    pairing_units_edit.setText(pairing_units_val.toString());
+    capacity.radio = pairing_units_val.toInt();
+
+    m_scheduler.setCapacity(capacity);
+}
+
+void MainWindow::loadTestPlan()
+{
+    QSettings settings("Seatex", "WingSlotTest");
+    auto filename = settings.value(QString("test_plan"), TEST_DEFAULT_PLAN).toString();
+    test_plan_edit.setText(filename);
+
+    TestPlan plan;
+    QString message;
+    if (!plan.load(filename)) {
+        message = plan.errorString();
+    } else if (EscFuncTest::setPlan(plan, message)) {
+        output() << QString("Test plan %1 version %2").arg(filename).arg(plan.version());
+        return;
+    }
+    output() << message;
+    if (filename != TEST_DEFAULT_PLAN && plan.load(TEST_DEFAULT_PLAN) && EscFuncTest::setPlan(plan, message)) {
+        output() << QString("Falling back on test plan %1 version %2").arg(TEST_DEFAULT_PLAN).arg(plan.version());
+    } else {
+        error();
+    }
 }
 
 void MainWindow::saveSettings(const QString &item, QVariant value)
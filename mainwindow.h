@@ -11,6 +11,7 @@
 #include "escfunctest.h"
 #include "escrecorder.h"
 #include "escmonitor.h"
+#include "testscheduler.h"
 
 #include <QPushButton>
 
@@ -22,7 +23,9 @@ public:
     ~MainWindow() = default;
 
 protected:
-    void startTest();
+    void connectScheduler();
+    void resumeTest();
+    void focusTest(WingSlot *unit);
     void resetTest();
 
     QWidget *makeContent();
@@ -33,15 +36,15 @@ protected:
 
     QWidget *makeSettings();
     void loadSettings();
+    void loadTestPlan();
     void saveSettings(const QString &item, QVariant value);
     bool isNumber(const QString &item);
     void findCommunicationServer(int argc, char** argv);
 
 private:
     WingSlot::SlotList m_units;
-    std::queue<WingSlot*> m_test_queue;
-
-    EscFuncTest *m_test = nullptr;
+    TestScheduler m_scheduler;
+    WingSlot *m_testFocus = nullptr;
     EscRecorder *m_recorder = nullptr;
 
     //Main widgets
@@ -74,6 +77,10 @@ private:
     QLineEdit wingLoss_edit;
     QLineEdit wingChargeCurrent_edit;
     QLineEdit packetLoss_edit;
+    QLineEdit parallel_units_edit;
+    QLineEdit charging_units_edit;
+    QLineEdit pairing_units_edit;
+    QLineEdit test_plan_edit;
 
     const int NUM_BUSSES = 7;
     const double LOAD_FACTOR = 0.05; // default 0.005 ?
@@ -85,6 +92,9 @@ private:
     const int TEST_DEFAULT_PASSIVE_DURATION = 15000;
     const int TEST_DEFAULT_PAIRING_DURATION = 30000;
     const int TEST_DEFAULT_ACTIVE_DURATION = 30000;
+    const int TEST_DEFAULT_PARALLEL_UNITS = 8;
+    const int TEST_DEFAULT_CHARGING_UNITS = 4;
+    const int TEST_DEFAULT_PAIRING_UNITS = 1;
     const double iSupply_noCharge_value = 8;
     const double iSupply_charge_value = 180;
     const double iSupplyWing_noCharge_value = 4;
@@ -92,6 +102,9 @@ private:
     const double wingLoss_value = 1;
     const double wingChargeCurrent_value = 48;
     const double packetLoss_value = 1;
+    const QString TEST_DEFAULT_PLAN = TestPlan::BUILTIN;
+    const QString TEST_JOURNAL = "/PALM/esctest_journal.json";
+    const QString RECORDER_PATH = "/PALM/log";
 };
 
 #endif // MAINWINDOW_H
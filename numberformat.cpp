@@ -0,0 +1,57 @@
+#include "numberformat.h"
+#include <charconv>
+#include <cmath>
+#include <algorithm>
+
+int NumberFormat::fixed(char *buffer, const double value, const int decimals, const bool trim)
+{
+    if (!std::isfinite(value) || std::fabs(value) >= FIXED_LIMIT) {
+        return shortest(buffer, value);
+    }
+    auto result = std::to_chars(buffer, buffer + BUFFER_SIZE, value, std::chars_format::fixed,
+                                std::min(std::max(decimals, 0), MAX_DECIMALS));
+    auto end = result.ptr;
+    if (trim && std::find(buffer, end, '.') != end) {
+        while (*(end - 1) == '0') {
+            --end;
+        }
+        if (*(end - 1) == '.') {
+            --end;
+        }
+    }
+    return static_cast<int>(end - buffer);
+}
+
+int NumberFormat::shortest(char *buffer, const double value)
+{
+    if (std::isnan(value)) {
+        std::copy_n("nan", 3, buffer);
+        return 3;
+    }
+    auto result = std::to_chars(buffer, buffer + BUFFER_SIZE, value);
+    return static_cast<int>(result.ptr - buffer);
+}
+
+int NumberFormat::integer(char *buffer, const qint64 value)
+{
+    auto result = std::to_chars(buffer, buffer + BUFFER_SIZE, value);
+    return static_cast<int>(result.ptr - buffer);
+}
+
+void NumberFormat::appendFixed(QByteArray &out, const double value, const int decimals, const bool trim)
+{
+    char buffer[BUFFER_SIZE];
+    out.append(buffer, fixed(buffer, value, decimals, trim));
+}
+
+void NumberFormat::appendInteger(QByteArray &out, const qint64 value)
+{
+    char buffer[BUFFER_SIZE];
+    out.append(buffer, integer(buffer, value));
+}
+
+QString NumberFormat::toFixed(const double value, const int decimals, const bool trim)
+{
+    char buffer[BUFFER_SIZE];
+    return QString::fromLatin1(buffer, fixed(buffer, value, decimals, trim));
+}
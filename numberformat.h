@@ -0,0 +1,28 @@
+#ifndef NUMBERFORMAT_H
+#define NUMBERFORMAT_H
+
+#include <QByteArray>
+#include <QString>
+
+// Locale independent number formatting into caller-owned buffers, no heap allocation
+class NumberFormat
+{
+public:
+    static const int BUFFER_SIZE = 64;
+
+    // Fixed decimals, trimmed like "\\.?0+$" would; values out of fixed range fall back to shortest
+    static int fixed(char *buffer, const double value, const int decimals, const bool trim = true);
+    // Shortest text that reads back to the same double
+    static int shortest(char *buffer, const double value);
+    static int integer(char *buffer, const qint64 value);
+
+    static void appendFixed(QByteArray &out, const double value, const int decimals, const bool trim = true);
+    static void appendInteger(QByteArray &out, const qint64 value);
+    static QString toFixed(const double value, const int decimals, const bool trim = true);
+
+private:
+    static constexpr int MAX_DECIMALS = 17;
+    static constexpr double FIXED_LIMIT = 1e40;
+};
+
+#endif // NUMBERFORMAT_H
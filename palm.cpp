@@ -1,135 +1,366 @@
 #include "palm.h"
+#include "palmwriter.h"
 
 #include <QDateTime>
-#include <QRegExp>
+#include <QDir>
+#include <algorithm>
 
 PALM::PALM(const QString &title)
     : m_title(title)
+    , m_format(Format::TEXT)
+    , m_pending(0)
+    , m_batch(false)
+    , m_batchTime(0)
+    , m_sync(false)
+    , m_atomic(false)
+    , m_rotateSize(0)
+    , m_compress(false)
+    , m_indexed(false)
+    , m_policy(Flush::ROW)
+    , m_flushValue(1)
+    , m_flushTicker(nullptr)
 {
     setPath("~");
-    m_header.push_back(QString("Product"));
-    m_header.push_back(QString("SerialNo"));
-    m_header.push_back(QString("Timestamp"));
-    m_header.push_back(QString("Import configuration"));
-    m_header.push_back(QString("Source"));
-    m_header.push_back(QString("User name"));
-    m_header.push_back(QString("Comment"));
-    m_header.push_back(QString("ProductFamily"));
-    m_header.push_back(QString("MACAddress"));
-    m_header.push_back(QString("FirmwareVersion"));
-    m_header.push_back(QString("Mode"));
-    m_header.push_back(QString("SerialNoCard"));
-    m_header.push_back(QString("HardwareRevision"));
-    m_header.push_back(QString("TestReport"));
-    m_header.push_back(QString("SoftwareVersion"));
-    m_header.push_back(QString("Free"));
+    for (const auto& name: PalmSchema::standardColumns()) {
+        m_schema.add(name, false);
+    }
+    m_timestamp = m_schema.column("Timestamp");
+    resolveKeys();
+    m_row.resize(m_schema.size());
+    // Reserved capacity survives resize(0), so rows are formatted into the same memory
+    m_buffer.reserve(BUFFER_RESERVE);
+}
+
+PALM::~PALM()
+{
+    closeFile();
+}
+
+void PALM::setFlushPolicy(const PALM::Flush policy, const int value)
+{
+    m_policy = policy;
+    m_flushValue = std::max(value, 1);
+    if (m_policy == Flush::INTERVAL) {
+        if (m_flushTicker == nullptr) {
+            m_flushTicker = EscClock::instance().createTicker(this);
+            connect(m_flushTicker, &EscTicker::timeout, this, &PALM::flush);
+        }
+        m_flushTicker->start(m_flushValue);
+    } else if (m_flushTicker != nullptr) {
+        m_flushTicker->stop();
+    }
+    flush();
+}
+
+void PALM::setFormat(const PALM::Format format)
+{
+    closeFile();
+    m_format = format;
 }
 
 void PALM::setTitle(const QString &title)
 {
+    closeFile();
     m_title = title;
 }
 
 void PALM::setPath(const QString &path)
 {
+    closeFile();
     m_path = (path.at(path.size() - 1) == '/') ? path : path + '/';
     if (m_path.at(0) == '~') {
         m_path.replace(0, 1, QString::fromUtf8(std::getenv("HOME")));
     }
 }
 
+QString PALM::path() const
+{
+    return m_path;
+}
+
 void PALM::addColumn(const std::vector<QString> &header)
 {
-    m_header.insert(m_header.end(), header.begin(), header.end());
-    m_customData.insert(m_customData.end(), header.begin(), header.end());
+    for (const auto& section: header) {
+        m_schema.add(section, true);
+    }
+    resolveKeys();
+    m_row.resize(m_schema.size());
 }
 
 void PALM::addColumn(const QString &section)
 {
-    m_header.push_back(section);
-    m_customData.push_back(section);
+    m_schema.add(section, true);
+    resolveKeys();
+    m_row.resize(m_schema.size());
+}
+
+const PalmSchema &PALM::schema() const
+{
+    return m_schema;
+}
+
+PALM::Column PALM::column(const QString &name) const
+{
+    return m_schema.column(name);
 }
 
 bool PALM::setValue(const QString &item, const QVariant &v)
 {
-    for (const auto& field: m_header) {
-        if (QString::compare(field, item) == 0) {
-            m_data[item] = QVariant::fromValue(v);
-            return true;
-        }
+    return setValue(m_schema.column(item), v);
+}
+
+bool PALM::setValue(const PALM::Column column, const QVariant &v)
+{
+    if (column < 0 || column >= m_schema.size()) {
+        return false;
     }
-    return false;
+    PalmSchema::set(m_row[column], v);
+    return true;
 }
 
-bool PALM::save()
+bool PALM::setValue(const PALM::Column column, const double value)
 {
-    FileResponse status;
-    QTextStream stream(openFile(status));
+    if (column < 0 || column >= m_schema.size()) {
+        return false;
+    }
+    m_row[column].type = PalmSchema::Type::DOUBLE;
+    m_row[column].number = value;
+    return true;
+}
 
-    if (status == FileResponse::ERROR) {
+bool PALM::setValue(const PALM::Column column, const float value)
+{
+    if (column < 0 || column >= m_schema.size()) {
         return false;
     }
-    if (status == FileResponse::NEW) {
-        writeHeader(stream);
+    m_row[column].type = PalmSchema::Type::FLOAT;
+    m_row[column].number = value;
+    return true;
+}
+
+bool PALM::setValue(const PALM::Column column, const int value)
+{
+    if (column < 0 || column >= m_schema.size()) {
+        return false;
     }
-    writeData(stream);
-    clearData();
-    stream.device()->close();
-    delete stream.device();
+    m_row[column].type = PalmSchema::Type::INT;
+    m_row[column].integer = value;
     return true;
 }
 
-QFile *PALM::openFile(PALM::FileResponse &status)
+bool PALM::setValue(const PALM::Column column, const bool value)
 {
-    auto file = new QFile;
-    auto filename = QString("%1_%2.txt").arg(m_title).arg(QDateTime::currentDateTime().toString("yyyy_MM_dd"));
-    file->setFileName(m_path + filename);
+    if (column < 0 || column >= m_schema.size()) {
+        return false;
+    }
+    m_row[column].type = PalmSchema::Type::BOOL;
+    m_row[column].number = value;
+    return true;
+}
 
-    if (!file->exists()) {
-        status = FileResponse::NEW;
+QVariant PALM::value(const PALM::Column column) const
+{
+    if (column < 0 || column >= m_schema.size()) {
+        return QVariant();
+    }
+    return PalmSchema::toVariant(m_row[column]);
+}
+
+bool PALM::save()
+{
+    if (!openFile()) {
+        return false;
+    }
+    m_row[m_timestamp].type = PalmSchema::Type::TIMESTAMP;
+    m_row[m_timestamp].integer = m_batch ? m_batchTime : QDateTime::currentMSecsSinceEpoch();
+    if (m_format == Format::COLUMNAR) {
+        m_columns.append(m_row);
     } else {
-        status = FileResponse::OPEN;
+        if (m_indexed) {
+            m_keys.push_back(key(static_cast<quint64>(m_buffer.size())));
+        }
+        writeData(m_buffer);
     }
-    if (!file->open(QIODevice::Append | QIODevice::Text)) {
-        status = FileResponse::ERROR;
+    clearData();
+
+    ++m_pending;
+    if (m_batch) {
+        return true;
     }
-    return file;
+    if (m_policy == Flush::ROW || (m_policy == Flush::ROWS && m_pending >= m_flushValue)) {
+        return flush();
+    }
+    return true;
 }
 
-void PALM::writeHeader(QTextStream &file)
+bool PALM::flush()
 {
-    for (const auto& field: m_header) {
-        file << field << ((field == m_header.at(m_header.size() - 1)) ? '\n' : '|');
+    m_pending = 0;
+    if (m_format == Format::COLUMNAR) {
+        return m_columns.flush();
     }
+    if (m_buffer.isEmpty()) {
+        return true;
+    }
+    // Whole rows in one record, the writer thread appends them in a single write
+    PalmWriter::Record record;
+    record.filename = m_filename;
+    record.header = m_headerData;
+    record.rows = m_buffer;
+    record.sync = m_sync;
+    record.atomic = m_atomic;
+    record.rotateSize = m_rotateSize;
+    record.compress = m_compress;
+    record.keys.swap(m_keys);
+    m_buffer = QByteArray();
+    m_buffer.reserve(BUFFER_RESERVE);
+    return PalmWriter::instance().submit(record);
+}
+
+void PALM::beginBatch()
+{
+    m_batch = true;
+    m_batchTime = QDateTime::currentMSecsSinceEpoch();
 }
 
-void PALM::writeData(QTextStream &file)
+bool PALM::commitBatch()
 {
-    setValue("Timestamp", QDateTime::currentDateTime().toString("yyyy-MM-ddThh:mm:ss"));
-    for (const auto& field: m_header) {
-        switch (m_data[field].type()) {
-        case QMetaType::Bool :
-            file << QString::number(m_data[field].toBool());
-            break;
+    m_batch = false;
+    return flush();
+}
 
-        case QMetaType::Double :
-            file << QString::number(m_data[field].toDouble(), 'f', FORMAT_DECIMALS).remove(QRegExp("\\.?0+$"));
-            break;
+void PALM::setSync(const bool sync)
+{
+    m_sync = sync;
+}
 
-        case QMetaType::Float :
-            file << QString::number(m_data[field].toFloat(), 'f', FORMAT_DECIMALS).remove(QRegExp("\\.?0+$"));
-            break;
+void PALM::setAtomic(const bool atomic)
+{
+    m_atomic = atomic;
+}
 
-        default:
-            file << m_data[field].toString();
+void PALM::setRotation(const qint64 maxSize, const bool compress)
+{
+    m_rotateSize = maxSize;
+    m_compress = compress;
+}
+
+void PALM::setIndexed(const bool indexed)
+{
+    m_indexed = indexed;
+}
+
+bool PALM::openFile()
+{
+    // A batch keeps its rows in the file of the day it was stamped with, even across midnight
+    auto date = m_batch ? QDateTime::fromMSecsSinceEpoch(m_batchTime).date() : QDate::currentDate();
+    if (date == m_date) {
+        return true;
+    }
+    auto previous = m_filename;
+    auto rollover = m_date.isValid() && m_format == Format::TEXT;
+    auto sealing = m_format == Format::TEXT && (m_rotateSize > 0 || m_compress);
+    closeFile();
+    if (rollover && sealing) {
+        sealFile(previous);
+    } else if (sealing) {
+        sealStale(date);
+    }
+
+    auto filename = QString("%1_%2").arg(m_title).arg(date.toString("yyyy_MM_dd"));
+    if (m_format == Format::COLUMNAR) {
+        if (!m_columns.open(m_path + filename + PalmColumns::SUFFIX, m_schema.names())) {
+            return false;
         }
-        file << ((field == m_header.at(m_header.size() - 1)) ? '\n' : '|');
+    } else {
+        m_filename = m_path + filename + ".txt";
+        m_headerData.resize(0);
+        writeHeader(m_headerData);
     }
+    m_date = date;
+    return true;
+}
+
+void PALM::sealFile(const QString &filename)
+{
+    PalmWriter::Record record;
+    record.filename = filename;
+    record.compress = m_compress;
+    record.seal = true;
+    PalmWriter::instance().submit(record);
+}
+
+void PALM::sealStale(const QDate &today)
+{
+    QDir dir(m_path);
+    for (const auto& name: dir.entryList(QStringList() << m_title + "_????_??_??.txt", QDir::Files)) {
+        auto date = QDate::fromString(name.mid(m_title.size() + 1, 10), "yyyy_MM_dd");
+        if (date.isValid() && date < today) {
+            sealFile(dir.filePath(name));
+        }
+    }
+}
+
+void PALM::closeFile()
+{
+    flush();
+    m_columns.close();
+    m_date = QDate();
+}
+
+void PALM::writeHeader(QByteArray &out)
+{
+    const auto &names = m_schema.names();
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        out.append(names[i].toLocal8Bit());
+        out.append((i + 1 == names.size()) ? '\n' : '|');
+    }
+}
+
+void PALM::writeData(QByteArray &out)
+{
+    for (std::size_t i = 0; i < m_row.size(); ++i) {
+        PalmSchema::append(out, m_row[i]);
+        out.append((i + 1 == m_row.size()) ? '\n' : '|');
+    }
+}
+
+QString PALM::format(const QVariant &value)
+{
+    PalmSchema::Slot slot;
+    PalmSchema::set(slot, value);
+    return PalmSchema::format(slot);
+}
+
+void PALM::resolveKeys()
+{
+    m_keyColumn = {
+        m_schema.column("SerialNo"),
+        m_schema.column("WingSerial"),
+        m_schema.column("Approved"),
+        m_schema.column("FirmwareVersion"),
+    };
+}
+
+PalmIndex::Key PALM::key(const quint64 offset) const
+{
+    auto slot = [&](const Column column){
+        return (column == PalmSchema::INVALID) ? PalmSchema::Slot() : m_row[column];
+    };
+    PalmIndex::Key key;
+    key.offset = offset;
+    key.timestamp = m_row[m_timestamp].integer;
+    key.serial = PalmSchema::toVariant(slot(m_keyColumn.serial)).toInt();
+    key.wingSerial = PalmSchema::toVariant(slot(m_keyColumn.wingSerial)).toInt();
+    auto approved = slot(m_keyColumn.approved);
+    key.approved = (approved.type == PalmSchema::Type::EMPTY) ? -1 : static_cast<qint8>(PalmSchema::toVariant(approved).toBool());
+    key.firmware = PalmSchema::toVariant(slot(m_keyColumn.firmware)).toString();
+    return key;
 }
 
 void PALM::clearData()
 {
-    for (const auto& field: m_customData) {
-        m_data.erase(field);
+    for (const auto& column: m_schema.customColumns()) {
+        m_row[column].type = PalmSchema::Type::EMPTY;
     }
 }
@@ -7,38 +7,107 @@
 #include <memory>
 #include <QFile>
 #include <QTextStream>
+#include <QDate>
+#include "escclock.h"
+#include "palmschema.h"
+#include "palmcolumns.h"
+#include "palmindex.h"
 
 class PALM : public QObject
 {
     Q_OBJECT
 public:
     PALM(const QString &title = QString("Untitled"));
+    ~PALM();
+
+    enum class Flush {
+        ROW,                                // Every saved row
+        ROWS,                               // Every n saved rows
+        INTERVAL,                           // Every n milliseconds
+    };
+    void setFlushPolicy(const Flush policy, const int value = 1);
+    enum class Format {
+        TEXT,                               // Pipe-delimited rows for the PALM importer
+        COLUMNAR,                           // Typed column blocks, see PalmColumns
+    };
+    void setFormat(const Format format);
+    // Text rows are fsync'ed by the log writer before it reports them done
+    void setSync(const bool sync);
+    // Each flush reaches the text log completely or not at all, see PalmWal
+    void setAtomic(const bool atomic);
+    // Text logs are sealed into numbered segments past maxSize [Bytes] and at the end of the day
+    void setRotation(const qint64 maxSize, const bool compress);
+    // Text rows are entered into the log directory's PalmIndex as they are written
+    void setIndexed(const bool indexed);
     void setTitle(const QString &title);
     void setPath(const QString &path);
+    QString path() const;
     void addColumn(const std::vector<QString> &header);
     void addColumn(const QString &section);
+    const PalmSchema &schema() const;
+
+    typedef PalmSchema::Column Column;
+    Column column(const QString &name) const;
     bool setValue(const QString &item, const QVariant &v);
+    bool setValue(const Column column, const QVariant &v);
+    // Handles from column() skip the name lookup, use these in per-row paths
+    bool setValue(const Column column, const double value);
+    bool setValue(const Column column, const float value);
+    bool setValue(const Column column, const int value);
+    bool setValue(const Column column, const bool value);
+    QVariant value(const Column column) const;
     bool save();
+    bool flush();
+    // Rows saved until commitBatch() share one timestamp and reach the writer as one record
+    void beginBatch();
+    bool commitBatch();
+    static QString format(const QVariant &value);
 
 protected:
-    enum class FileResponse {
-        ERROR,
-        OPEN,
-        NEW,
-    };
-    QFile* openFile(FileResponse &status);
-    void writeHeader(QTextStream &file);
-    void writeData(QTextStream &file);
+    bool openFile();
+    void closeFile();
+    void sealFile(const QString &filename);
+    // Seals daily files older than today left unsealed by a previous run
+    void sealStale(const QDate &today);
+    void writeHeader(QByteArray &out);
+    void writeData(QByteArray &out);
     void clearData();
+    void resolveKeys();
+    PalmIndex::Key key(const quint64 offset) const;
 
 private:
     QString m_title;
     QString m_path;
-    std::vector<QString> m_header;
-    std::vector<QString> m_customData;
-    std::map<QString, QVariant> m_data;
+    PalmSchema m_schema;
+    PalmSchema::Row m_row;
+    Column m_timestamp;
+    struct {
+        Column serial;
+        Column wingSerial;
+        Column approved;
+        Column firmware;
+    } m_keyColumn;
+
+    Format m_format;
+    QString m_filename;
+    QByteArray m_headerData;
+    PalmColumnWriter m_columns;
+    QDate m_date;
+    QByteArray m_buffer;
+    int m_pending;
+    bool m_batch;
+    qint64 m_batchTime;                     // [Milliseconds since epoch]
+    bool m_sync;
+    bool m_atomic;
+    qint64 m_rotateSize;
+    bool m_compress;
+    bool m_indexed;
+    std::vector<PalmIndex::Key> m_keys;
+    Flush m_policy;
+    int m_flushValue;
+    EscTicker *m_flushTicker;
 
-    const int FORMAT_DECIMALS = 5;
+    static const int BUFFER_RESERVE = 4096;
 };
 
 #endif // PALM_H
@@ -0,0 +1,281 @@
+#include "palmarchive.h"
+#include "palmwal.h"
+#include <QFileInfo>
+
+const QString PalmArchive::SUFFIX = QString(".qz");
+const QString PalmArchive::SEALING_SUFFIX = QString(".sealing");
+
+
+bool PalmArchive::seal(const QString &source, const QString &dailyFile, const bool compress, QString &target)
+{
+    target.clear();
+
+    // A marker names the segment while the source still exists; if that segment made it, the source is a leftover
+    QFile marker(source + SEALING_SUFFIX);
+    if (marker.open(QIODevice::ReadOnly)) {
+        auto sealed = QString::fromUtf8(marker.readAll());
+        marker.close();
+        if (!sealed.isEmpty() && QFile::exists(sealed)) {
+            target = sealed;
+            return (!QFile::exists(source) || QFile::remove(source)) && marker.remove();
+        }
+        marker.remove();
+    }
+
+    for (int n = 1; n <= MAX_SEGMENTS; ++n) {
+        auto plain = QString("%1.%2").arg(dailyFile).arg(n);
+        if (!QFile::exists(plain) && !QFile::exists(plain + SUFFIX)) {
+            target = compress ? plain + SUFFIX : plain;
+            break;
+        }
+    }
+    if (target.isEmpty()) {
+        return false;
+    }
+    if (!compress) {
+        return QFile::rename(source, target);
+    }
+
+    QFile in(source);
+    QFile out(target + ".part");
+    if (!in.open(QIODevice::ReadOnly) || !out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    QDataStream stream(&out);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << MAGIC;
+    while (!in.atEnd()) {
+        // Bounded chunks keep memory flat no matter how large the segment grew
+        stream << qCompress(in.read(CHUNK_SIZE));
+    }
+    // On disk before the rename, or a power loss could leave a truncated segment and no source
+    if (stream.status() != QDataStream::Ok || !PalmWal::sync(out)) {
+        out.remove();
+        return false;
+    }
+    out.close();
+    in.close();
+
+    const auto name = target.toUtf8();
+    if (!marker.open(QIODevice::WriteOnly | QIODevice::Truncate) || marker.write(name) != name.size() || !PalmWal::sync(marker)) {
+        marker.remove();
+        out.remove();
+        return false;
+    }
+    marker.close();
+    if (!out.rename(target)) {
+        marker.remove();
+        return false;
+    }
+    return QFile::remove(source) && marker.remove();
+}
+
+QStringList PalmArchive::segments(const QString &dailyFile)
+{
+    QStringList segments;
+    for (int n = 1; n <= MAX_SEGMENTS; ++n) {
+        auto plain = QString("%1.%2").arg(dailyFile).arg(n);
+        if (QFile::exists(plain + SUFFIX)) {
+            segments << plain + SUFFIX;
+        } else if (QFile::exists(plain)) {
+            segments << plain;
+        } else {
+            break;
+        }
+    }
+    if (QFile::exists(dailyFile)) {
+        segments << dailyFile;
+    }
+    return segments;
+}
+
+bool PalmArchive::inflate(const QString &segment, QByteArray &data)
+{
+    QFile file(segment);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    quint64 magic;
+    stream >> magic;
+    if (magic != MAGIC) {
+        return false;
+    }
+    data.clear();
+    while (!file.atEnd()) {
+        QByteArray chunk;
+        stream >> chunk;
+        if (stream.status() != QDataStream::Ok) {
+            return false;
+        }
+        data.append(qUncompress(chunk));
+    }
+    return true;
+}
+
+bool PalmArchive::readAt(const QString &segment, const quint64 offset, QByteArray &line)
+{
+    QFile file(segment);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    if (!segment.endsWith(SUFFIX)) {
+        if (!file.seek(static_cast<qint64>(offset))) {
+            return false;
+        }
+        line = file.readLine();
+        return !line.isEmpty();
+    }
+
+    QDataStream stream(&file);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    quint64 magic;
+    stream >> magic;
+    if (magic != MAGIC) {
+        return false;
+    }
+    // Chunks before the row are decompressed and dropped, the row may span two chunks
+    quint64 position = 0;
+    QByteArray data;
+    while (!file.atEnd()) {
+        QByteArray chunk;
+        stream >> chunk;
+        if (stream.status() != QDataStream::Ok) {
+            return false;
+        }
+        auto block = qUncompress(chunk);
+        if (data.isEmpty() && position + static_cast<quint64>(block.size()) <= offset) {
+            position += static_cast<quint64>(block.size());
+            continue;
+        }
+        if (data.isEmpty()) {
+            data = block.mid(static_cast<int>(offset - position));
+        } else {
+            data.append(block);
+        }
+        auto end = data.indexOf('\n');
+        if (end >= 0) {
+            line = data.left(end + 1);
+            return true;
+        }
+    }
+    line = data;
+    return !line.isEmpty();
+}
+
+PalmArchive::PalmArchive()
+    : m_segment(-1)
+    , m_compressed(false)
+    , m_position(0)
+    , m_header(false)
+{
+    m_stream.setByteOrder(QDataStream::LittleEndian);
+}
+
+bool PalmArchive::open(const QString &dailyFile)
+{
+    close();
+    m_segments = segments(dailyFile);
+    if (m_segments.isEmpty()) {
+        m_error = QString("No log found for %1").arg(dailyFile);
+        return false;
+    }
+    return true;
+}
+
+bool PalmArchive::readLine(QByteArray &line)
+{
+    while (true) {
+        auto end = m_data.indexOf('\n', m_position);
+        if (end >= 0) {
+            line = m_data.mid(m_position, end - m_position + 1);
+            m_position = end + 1;
+            // Every segment starts with the header, only the first one is passed on
+            if (m_header) {
+                m_header = false;
+                if (m_segment > 0) {
+                    continue;
+                }
+            }
+            return true;
+        }
+        if (!fill()) {
+            if (m_position < m_data.size()) {
+                line = m_data.mid(m_position);
+                m_position = m_data.size();
+                return true;
+            }
+            return false;
+        }
+    }
+}
+
+void PalmArchive::close()
+{
+    m_file.close();
+    m_segments.clear();
+    m_segment = -1;
+    m_data.clear();
+    m_position = 0;
+}
+
+QString PalmArchive::errorString() const
+{
+    return m_error;
+}
+
+bool PalmArchive::nextSegment()
+{
+    m_file.close();
+    if (++m_segment >= m_segments.size()) {
+        return false;
+    }
+    m_file.setFileName(m_segments[m_segment]);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    m_compressed = m_file.fileName().endsWith(SUFFIX);
+    m_header = true;
+    if (m_compressed) {
+        m_stream.setDevice(&m_file);
+        quint64 magic;
+        m_stream >> magic;
+        if (magic != MAGIC) {
+            m_error = QString("%1 is not a PALM log segment").arg(m_file.fileName());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PalmArchive::fill()
+{
+    // Keep the unfinished line and append the next chunk behind it
+    m_data.remove(0, m_position);
+    m_position = 0;
+    while (true) {
+        if (m_file.isOpen() && !m_file.atEnd()) {
+            if (m_compressed) {
+                QByteArray chunk;
+                m_stream >> chunk;
+                if (m_stream.status() != QDataStream::Ok) {
+                    m_error = QString("%1 is truncated").arg(m_file.fileName());
+                    return false;
+                }
+                m_data.append(qUncompress(chunk));
+            } else {
+                m_data.append(m_file.read(CHUNK_SIZE));
+            }
+            return true;
+        }
+        if (!m_data.isEmpty()) {
+            // A segment ended without a newline; hand it out before switching
+            return false;
+        }
+        if (!nextSegment()) {
+            return false;
+        }
+    }
+}
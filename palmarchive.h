@@ -0,0 +1,57 @@
+#ifndef PALMARCHIVE_H
+#define PALMARCHIVE_H
+
+#include <QString>
+#include <QStringList>
+#include <QFile>
+#include <QDataStream>
+#include <QByteArray>
+
+// Sealed PALM log segments: <daily file>.<n>.qz, a stream of qCompress'ed chunks
+//
+//   segment := MAGIC chunk*
+//   chunk   := quint32 length, qCompress(data)
+class PalmArchive
+{
+public:
+    static const QString SUFFIX;
+    static const QString SEALING_SUFFIX;
+
+    // Compresses the source into the next free segment of the daily file and removes the source.
+    // A source left behind by a seal cut short after its segment was written is only removed
+    static bool seal(const QString &source, const QString &dailyFile, const bool compress, QString &target);
+    // Decompresses a whole segment
+    static bool inflate(const QString &segment, QByteArray &data);
+    // Reads the line starting at offset [Bytes] of the uncompressed segment
+    static bool readAt(const QString &segment, const quint64 offset, QByteArray &line);
+    // Sealed segments in write order, followed by the live daily file if it exists
+    static QStringList segments(const QString &dailyFile);
+
+    PalmArchive();
+    // Reads every segment of a day as one text log with a single header line
+    bool open(const QString &dailyFile);
+    bool readLine(QByteArray &line);
+    void close();
+    QString errorString() const;
+
+protected:
+    bool nextSegment();
+    bool fill();
+
+private:
+    QStringList m_segments;
+    int m_segment;
+    QFile m_file;
+    QDataStream m_stream;
+    bool m_compressed;
+    QByteArray m_data;
+    int m_position;
+    bool m_header;
+    QString m_error;
+
+    static const quint64 MAGIC = 0x31305a514d4c4150;   // "PALMQZ01"
+    static const int CHUNK_SIZE = 1 << 20;
+    static const int MAX_SEGMENTS = 9999;
+};
+
+#endif // PALMARCHIVE_H
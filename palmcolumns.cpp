@@ -0,0 +1,519 @@
+#include "palmcolumns.h"
+#include "palm.h"
+#include <QDateTime>
+#include <algorithm>
+#include <cmath>
+
+const QString PalmColumns::SUFFIX = QString(".palmc");
+
+
+bool PalmColumns::readIndex(QFile &file)
+{
+    m_header.clear();
+    m_blocks.clear();
+    if (file.size() < FILE_HEADER_SIZE + TRAILER_SIZE) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    prepare(stream);
+    file.seek(file.size() - TRAILER_SIZE);
+    qint64 footerOffset;
+    quint32 magic;
+    stream >> footerOffset >> magic;
+    if (magic != END_MAGIC || footerOffset < FILE_HEADER_SIZE || footerOffset > file.size() - TRAILER_SIZE) {
+        return false;
+    }
+
+    file.seek(footerOffset);
+    quint32 count;
+    stream >> magic >> count;
+    if (magic != INDEX_MAGIC) {
+        return false;
+    }
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QString name;
+        stream >> name;
+        m_header.push_back(name);
+    }
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        Block block;
+        qint32 rows;
+        stream >> block.offset >> rows >> block.first >> block.last;
+        block.rows = rows;
+        m_blocks.push_back(block);
+    }
+    m_footerOffset = footerOffset;
+    return stream.status() == QDataStream::Ok;
+}
+
+bool PalmColumns::recoverIndex(QFile &file)
+{
+    // A write was cut short; keep every complete block and drop the rest
+    m_blocks.clear();
+    QDataStream stream(&file);
+    prepare(stream);
+    file.seek(FILE_HEADER_SIZE);
+
+    while (true) {
+        const auto offset = file.pos();
+        quint32 magic, rows, count;
+        stream >> magic >> rows >> count;
+        if (stream.status() != QDataStream::Ok || magic != BLOCK_MAGIC) {
+            m_footerOffset = offset;
+            break;
+        }
+
+        Block block = {offset, static_cast<int>(rows), 0, 0};
+        bool complete = true;
+        for (quint32 i = 0; i < count && complete; ++i) {
+            QString name;
+            quint8 type;
+            quint32 bytes;
+            stream >> name >> type >> bytes;
+            complete = stream.status() == QDataStream::Ok && file.pos() + bytes <= file.size();
+            if (complete && m_blocks.empty() && m_header.size() < count) {
+                m_header.push_back(name);
+            }
+            if (complete && name == "Timestamp" && static_cast<Type>(type) == Type::TIMESTAMP && rows > 0) {
+                const auto start = file.pos();
+                stream >> block.first;
+                file.seek(start + (rows - 1) * sizeof(qint64));
+                stream >> block.last;
+                file.seek(start);
+            }
+            complete = complete && file.seek(file.pos() + bytes);
+        }
+        if (!complete) {
+            m_footerOffset = offset;
+            break;
+        }
+        m_blocks.push_back(block);
+    }
+    return true;
+}
+
+void PalmColumns::prepare(QDataStream &stream)
+{
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::DoublePrecision);
+}
+
+
+PalmColumnWriter::PalmColumnWriter()
+    : m_rows(0)
+{
+    m_footerOffset = FILE_HEADER_SIZE;
+}
+
+PalmColumnWriter::~PalmColumnWriter()
+{
+    close();
+}
+
+bool PalmColumnWriter::open(const QString &filename, const std::vector<QString> &header)
+{
+    close();
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+
+    if (m_file.size() == 0) {
+        QDataStream stream(&m_file);
+        prepare(stream);
+        stream << MAGIC << VERSION;
+        m_blocks.clear();
+        m_footerOffset = FILE_HEADER_SIZE;
+    } else {
+        QDataStream stream(&m_file);
+        prepare(stream);
+        quint32 magic;
+        quint16 version;
+        stream >> magic >> version;
+        if (magic != MAGIC || version != VERSION) {
+            m_error = QString("%1 is not a columnar PALM log").arg(filename);
+            m_file.close();
+            return false;
+        }
+        if (!readIndex(m_file)) {
+            recoverIndex(m_file);
+        }
+    }
+    m_header = header;
+    return true;
+}
+
+void PalmColumnWriter::close()
+{
+    if (m_file.isOpen()) {
+        flush();
+        m_file.close();
+    }
+}
+
+bool PalmColumnWriter::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+void PalmColumnWriter::append(const PalmSchema::Row &row)
+{
+    m_pending.resize(m_header.size());
+    for (std::size_t i = 0; i < m_pending.size(); ++i) {
+        m_pending[i].push_back((i < row.size()) ? row[i] : PalmSchema::Slot());
+    }
+    ++m_rows;
+}
+
+bool PalmColumnWriter::flush()
+{
+    if (m_rows == 0 || !m_file.isOpen()) {
+        return true;
+    }
+
+    Block block = {m_footerOffset, m_rows, 0, 0};
+    auto timestamp = std::find(m_header.begin(), m_header.end(), QString("Timestamp"));
+    if (timestamp != m_header.end()) {
+        const auto &timestamps = m_pending[timestamp - m_header.begin()];
+        block.first = timestamps.front().integer;
+        block.last = timestamps.back().integer;
+    }
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    prepare(stream);
+    stream << BLOCK_MAGIC << static_cast<quint32>(m_rows) << static_cast<quint32>(m_header.size());
+    for (std::size_t i = 0; i < m_header.size(); ++i) {
+        const auto type = columnType(m_pending[i]);
+        const auto payload = encode(m_pending[i], type);
+        stream << m_header[i] << static_cast<quint8>(type) << static_cast<quint32>(payload.size());
+        stream.writeRawData(payload.constData(), payload.size());
+    }
+    m_blocks.push_back(block);
+    m_footerOffset += data.size();
+    writeFooter(stream);
+
+    // The block and its footer go out in one write over the previous footer
+    m_pending.clear();
+    m_rows = 0;
+    if (!m_file.seek(block.offset) || m_file.write(data) != data.size() || !m_file.flush()) {
+        m_error = m_file.errorString();
+        return false;
+    }
+    m_file.resize(m_file.pos());
+    return true;
+}
+
+QString PalmColumnWriter::errorString() const
+{
+    return m_error;
+}
+
+PalmColumns::Type PalmColumnWriter::columnType(const std::vector<PalmSchema::Slot> &values) const
+{
+    auto type = Type::EMPTY;
+    for (const auto& value: values) {
+        Type next;
+        switch (value.type) {
+        case PalmSchema::Type::EMPTY :
+            continue;
+
+        case PalmSchema::Type::BOOL :
+            next = Type::BOOL;
+            break;
+
+        case PalmSchema::Type::INT :
+            next = Type::INT;
+            break;
+
+        case PalmSchema::Type::FLOAT :
+        case PalmSchema::Type::DOUBLE :
+            next = Type::DOUBLE;
+            break;
+
+        case PalmSchema::Type::TIMESTAMP :
+            next = Type::TIMESTAMP;
+            break;
+
+        default:
+            return Type::STRING;
+        }
+        if (type == Type::EMPTY || type == next) {
+            type = next;
+        } else if ((type == Type::INT && next == Type::DOUBLE) || (type == Type::DOUBLE && next == Type::INT)) {
+            type = Type::DOUBLE;
+        } else {
+            // Mixed types keep their text form
+            return Type::STRING;
+        }
+    }
+    return type;
+}
+
+QByteArray PalmColumnWriter::encode(const std::vector<PalmSchema::Slot> &values, const PalmColumns::Type type) const
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    prepare(stream);
+
+    switch (type) {
+    case Type::EMPTY :
+        break;
+
+    case Type::BOOL :
+        for (const auto& value: values) {
+            stream << static_cast<quint8>((value.type != PalmSchema::Type::EMPTY) ? (value.number != 0.0) : NULL_BOOL);
+        }
+        break;
+
+    case Type::INT :
+    case Type::TIMESTAMP :
+        for (const auto& value: values) {
+            stream << ((value.type != PalmSchema::Type::EMPTY) ? value.integer : NULL_INT);
+        }
+        break;
+
+    case Type::DOUBLE :
+        for (const auto& value: values) {
+            if (value.type == PalmSchema::Type::EMPTY) {
+                stream << std::numeric_limits<double>::quiet_NaN();
+            } else {
+                stream << ((value.type == PalmSchema::Type::INT) ? static_cast<double>(value.integer) : value.number);
+            }
+        }
+        break;
+
+    case Type::STRING : {
+        std::vector<QString> dictionary;
+        std::map<QString, quint32> lookup;
+        std::vector<quint32> indices;
+        for (const auto& value: values) {
+            if (value.type == PalmSchema::Type::EMPTY) {
+                indices.push_back(NULL_INDEX);
+                continue;
+            }
+            auto text = PalmSchema::format(value);
+            auto entry = lookup.find(text);
+            if (entry == lookup.end()) {
+                entry = lookup.emplace(text, static_cast<quint32>(dictionary.size())).first;
+                dictionary.push_back(text);
+            }
+            indices.push_back(entry->second);
+        }
+        stream << static_cast<quint32>(dictionary.size());
+        for (const auto& text: dictionary) {
+            stream << text;
+        }
+        for (const auto& index: indices) {
+            stream << index;
+        }
+        break;
+    }
+    }
+    return payload;
+}
+
+void PalmColumnWriter::writeFooter(QDataStream &stream) const
+{
+    stream << INDEX_MAGIC << static_cast<quint32>(m_header.size());
+    for (const auto& field: m_header) {
+        stream << field;
+    }
+    stream << static_cast<quint32>(m_blocks.size());
+    for (const auto& block: m_blocks) {
+        stream << block.offset << static_cast<qint32>(block.rows) << block.first << block.last;
+    }
+    stream << m_footerOffset << END_MAGIC;
+}
+
+
+QVariant PalmColumnReader::Column::value(const int row) const
+{
+    if (type == Type::STRING) {
+        auto index = indices[row];
+        return (index < dictionary.size()) ? QVariant(dictionary[index]) : QVariant();
+    }
+    if (type == Type::EMPTY || std::isnan(numbers[row])) {
+        return QVariant();
+    }
+    switch (type) {
+    case Type::BOOL :
+        return QVariant(numbers[row] != 0.0);
+    case Type::INT :
+        return QVariant(static_cast<qlonglong>(numbers[row]));
+    case Type::TIMESTAMP :
+        return QVariant(QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(numbers[row])));
+    default:
+        return QVariant(numbers[row]);
+    }
+}
+
+PalmColumnReader::PalmColumnReader()
+{
+    m_footerOffset = FILE_HEADER_SIZE;
+}
+
+bool PalmColumnReader::open(const QString &filename)
+{
+    m_file.close();
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&m_file);
+    prepare(stream);
+    quint32 magic;
+    quint16 version;
+    stream >> magic >> version;
+    if (magic != MAGIC || version != VERSION) {
+        m_error = QString("%1 is not a columnar PALM log").arg(filename);
+        return false;
+    }
+    if (!readIndex(m_file)) {
+        recoverIndex(m_file);
+    }
+    return true;
+}
+
+const std::vector<QString> &PalmColumnReader::header() const
+{
+    return m_header;
+}
+
+const std::vector<PalmColumns::Block> &PalmColumnReader::blocks() const
+{
+    return m_blocks;
+}
+
+bool PalmColumnReader::readBlock(const std::size_t index, const QStringList &names, std::vector<PalmColumnReader::Column> &columns)
+{
+    columns.clear();
+    if (index >= m_blocks.size() || !m_file.seek(m_blocks[index].offset)) {
+        m_error = QString("Block %1 is out of range").arg(index);
+        return false;
+    }
+
+    QDataStream stream(&m_file);
+    prepare(stream);
+    quint32 magic, rows, count;
+    stream >> magic >> rows >> count;
+    if (magic != BLOCK_MAGIC) {
+        m_error = QString("Block %1 is corrupt").arg(index);
+        return false;
+    }
+
+    for (quint32 i = 0; i < count; ++i) {
+        Column column;
+        quint8 type;
+        quint32 bytes;
+        stream >> column.name >> type >> bytes;
+        column.type = static_cast<Type>(type);
+        const auto next = m_file.pos() + bytes;
+        // Columns that were not asked for are skipped without decoding
+        if (names.isEmpty() || names.contains(column.name)) {
+            if (!decode(stream, static_cast<int>(rows), column)) {
+                m_error = QString("Column %1 in block %2 is corrupt").arg(column.name).arg(index);
+                return false;
+            }
+            columns.push_back(std::move(column));
+        }
+        m_file.seek(next);
+    }
+    return stream.status() == QDataStream::Ok;
+}
+
+bool PalmColumnReader::exportText(QTextStream &out)
+{
+    const QStringList none;
+    for (std::size_t i = 0; i < m_header.size(); ++i) {
+        out << m_header[i] << ((i + 1 == m_header.size()) ? '\n' : '|');
+    }
+
+    std::vector<Column> columns;
+    for (std::size_t b = 0; b < m_blocks.size(); ++b) {
+        if (!readBlock(b, none, columns)) {
+            return false;
+        }
+        std::vector<const Column*> layout;
+        for (const auto& field: m_header) {
+            auto column = std::find_if(columns.begin(), columns.end(), [&](const Column &c){
+                return c.name == field;
+            });
+            layout.push_back((column != columns.end()) ? &*column : nullptr);
+        }
+        for (int row = 0; row < m_blocks[b].rows; ++row) {
+            for (std::size_t i = 0; i < layout.size(); ++i) {
+                if (layout[i] != nullptr) {
+                    out << PALM::format(layout[i]->value(row));
+                }
+                out << ((i + 1 == layout.size()) ? '\n' : '|');
+            }
+        }
+    }
+    return true;
+}
+
+QString PalmColumnReader::errorString() const
+{
+    return m_error;
+}
+
+bool PalmColumnReader::decode(QDataStream &stream, const int rows, PalmColumnReader::Column &column)
+{
+    switch (column.type) {
+    case Type::EMPTY :
+        column.numbers.assign(rows, std::numeric_limits<double>::quiet_NaN());
+        break;
+
+    case Type::BOOL :
+        column.numbers.resize(rows);
+        for (auto& number: column.numbers) {
+            quint8 value;
+            stream >> value;
+            number = (value == NULL_BOOL) ? std::numeric_limits<double>::quiet_NaN() : value;
+        }
+        break;
+
+    case Type::INT :
+    case Type::TIMESTAMP :
+        column.numbers.resize(rows);
+        for (auto& number: column.numbers) {
+            qint64 value;
+            stream >> value;
+            number = (value == NULL_INT) ? std::numeric_limits<double>::quiet_NaN() : static_cast<double>(value);
+        }
+        break;
+
+    case Type::DOUBLE :
+        column.numbers.resize(rows);
+        for (auto& number: column.numbers) {
+            stream >> number;
+        }
+        break;
+
+    case Type::STRING : {
+        quint32 size;
+        stream >> size;
+        for (quint32 i = 0; i < size && stream.status() == QDataStream::Ok; ++i) {
+            QString text;
+            stream >> text;
+            column.dictionary.push_back(text);
+        }
+        column.indices.resize(rows);
+        for (auto& index: column.indices) {
+            stream >> index;
+        }
+        break;
+    }
+
+    default:
+        return false;
+    }
+    return stream.status() == QDataStream::Ok;
+}
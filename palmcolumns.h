@@ -0,0 +1,113 @@
+#ifndef PALMCOLUMNS_H
+#define PALMCOLUMNS_H
+
+#include <QFile>
+#include <QDataStream>
+#include <QTextStream>
+#include <QStringList>
+#include <QVariant>
+#include <vector>
+#include <map>
+#include <limits>
+#include "palmschema.h"
+
+// Binary PALM log: typed column blocks followed by a footer indexing every block
+//
+//   file    := MAGIC version block* footer trailer
+//   block   := BLOCK_MAGIC rows columns (name type bytes payload)*
+//   footer  := INDEX_MAGIC header (offset rows first last)*
+//   trailer := footerOffset END_MAGIC
+class PalmColumns
+{
+public:
+    enum class Type : quint8 {
+        EMPTY,                              // Every row is null
+        BOOL,                               // quint8, NULL_BOOL is null
+        INT,                                // qint64, NULL_INT is null
+        DOUBLE,                             // double, NaN is null
+        TIMESTAMP,                          // qint64 [Milliseconds since epoch], NULL_INT is null
+        STRING,                             // Dictionary of QString, quint32 index per row, NULL_INDEX is null
+    };
+    struct Block {
+        qint64 offset;
+        int rows;
+        qint64 first;                       // [Milliseconds since epoch] Timestamp range of the block
+        qint64 last;
+    };
+
+    static const QString SUFFIX;
+
+protected:
+    bool readIndex(QFile &file);
+    bool recoverIndex(QFile &file);
+    static void prepare(QDataStream &stream);
+
+    std::vector<QString> m_header;
+    std::vector<Block> m_blocks;
+    qint64 m_footerOffset;
+    QString m_error;
+
+    static constexpr quint32 MAGIC = 0x50414c4d;          // "PALM"
+    static constexpr quint32 BLOCK_MAGIC = 0x50424c4b;    // "PBLK"
+    static constexpr quint32 INDEX_MAGIC = 0x50494458;    // "PIDX"
+    static constexpr quint32 END_MAGIC = 0x50454e44;      // "PEND"
+    static constexpr quint16 VERSION = 1;
+    static constexpr quint8 NULL_BOOL = 0xff;
+    static constexpr qint64 NULL_INT = std::numeric_limits<qint64>::min();
+    static constexpr quint32 NULL_INDEX = 0xffffffff;
+    static constexpr int FILE_HEADER_SIZE = 6;
+    static constexpr int TRAILER_SIZE = 12;
+};
+
+class PalmColumnWriter : public PalmColumns
+{
+public:
+    PalmColumnWriter();
+    ~PalmColumnWriter();
+    bool open(const QString &filename, const std::vector<QString> &header);
+    void close();
+    bool isOpen() const;
+    void append(const PalmSchema::Row &row);
+    bool flush();
+    QString errorString() const;
+
+protected:
+    Type columnType(const std::vector<PalmSchema::Slot> &values) const;
+    QByteArray encode(const std::vector<PalmSchema::Slot> &values, const Type type) const;
+    void writeFooter(QDataStream &stream) const;
+
+private:
+    QFile m_file;
+    std::vector<std::vector<PalmSchema::Slot>> m_pending;
+    int m_rows;
+};
+
+class PalmColumnReader : public PalmColumns
+{
+public:
+    struct Column {
+        QString name;
+        Type type;
+        std::vector<double> numbers;        // BOOL, INT, DOUBLE and TIMESTAMP rows, NaN is null
+        std::vector<QString> dictionary;
+        std::vector<quint32> indices;       // STRING rows
+        QVariant value(const int row) const;
+    };
+
+    PalmColumnReader();
+    bool open(const QString &filename);
+    const std::vector<QString> &header() const;
+    const std::vector<Block> &blocks() const;
+    // Reads the named columns of a block, or every column when none are named
+    bool readBlock(const std::size_t index, const QStringList &names, std::vector<Column> &columns);
+    bool exportText(QTextStream &out);
+    QString errorString() const;
+
+protected:
+    bool decode(QDataStream &stream, const int rows, Column &column);
+
+private:
+    QFile m_file;
+};
+
+#endif // PALMCOLUMNS_H
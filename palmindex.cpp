@@ -0,0 +1,481 @@
+#include "palmindex.h"
+#include "palmarchive.h"
+#include <QDir>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+
+const QString PalmIndex::DIRECTORY = QString(".palmindex");
+
+static_assert(sizeof(PalmIndex::Entry) == 32, "Index entries are fixed width on disk");
+
+static const char *POSTING_NAMES[] = {"serial.idx", "wing.idx", "time.idx"};
+
+
+PalmIndex::PalmIndex(const QString &directory)
+    : m_directory(QDir(directory).absolutePath())
+    , m_path(QDir(directory).absoluteFilePath(DIRECTORY) + "/")
+    , m_filesRead(0)
+    , m_firmwareRead(0)
+{
+
+}
+
+bool PalmIndex::open()
+{
+    m_files.clear();
+    m_names.clear();
+    m_firmware.clear();
+    m_versions.clear();
+    m_filesRead = 0;
+    m_firmwareRead = 0;
+    if (!QDir().mkpath(m_path)) {
+        m_error = QString("Could not create %1").arg(m_path);
+        return false;
+    }
+    refresh();
+    return true;
+}
+
+bool PalmIndex::append(const QString &filename, const qint64 size, const std::vector<PalmIndex::Key> &keys)
+{
+    QLockFile guard(m_path + "lock");
+    if (!lock(guard) || !appendEntries(filename, size, keys)) {
+        return false;
+    }
+
+    QFileInfo entries(m_path + "entries.dat");
+    const auto count = static_cast<quint64>(entries.size()) / sizeof(Entry);
+    const auto done = std::min(covered(), count);
+    if (count - done > std::max(MERGE_ENTRIES, done / 8)) {
+        return mergePostings();
+    }
+    return true;
+}
+
+void PalmIndex::moved(const QString &from, const QString &to)
+{
+    QLockFile guard(m_path + "lock");
+    if (!lock(guard)) {
+        return;
+    }
+    auto entry = m_files.find(from);
+    if (entry == m_files.end()) {
+        return;
+    }
+    auto file = entry->second;
+    m_files.erase(entry);
+    m_names[file.id] = to;
+    m_files[to] = file;
+    writeFile(to, file);
+}
+
+int PalmIndex::build(QStringList &report)
+{
+    QLockFile guard(m_path + "lock");
+    if (!lock(guard)) {
+        report << m_error;
+        return 0;
+    }
+    int rows = 0;
+    QDir dir(m_directory);
+    for (const auto& name: dir.entryList(QStringList() << "*.txt", QDir::Files, QDir::Name)) {
+        auto filename = dir.absoluteFilePath(name);
+        auto parsed = file(filename);
+        if (parsed.size >= QFileInfo(filename).size()) {
+            continue;
+        }
+        std::vector<Key> keys;
+        if (!parseRows(filename, parsed, keys)) {
+            report << QString("%1: %2").arg(name).arg(m_error);
+            continue;
+        }
+        if (!keys.empty()) {
+            report << QString("%1: %2 rows").arg(name).arg(keys.size());
+        }
+        rows += static_cast<int>(keys.size());
+        if (!writeEntries(filename, parsed.size, keys)) {
+            report << QString("%1: %2").arg(name).arg(m_error);
+        }
+    }
+    if (!mergePostings()) {
+        report << m_error;
+    }
+    return rows;
+}
+
+bool PalmIndex::merge()
+{
+    QLockFile guard(m_path + "lock");
+    return lock(guard) && mergePostings();
+}
+
+std::vector<PalmIndex::Match> PalmIndex::query(const PalmIndex::Query &query)
+{
+    std::vector<Match> matches;
+    refresh();
+    QFile entries(m_path + "entries.dat");
+    if (!entries.open(QIODevice::ReadOnly) || entries.size() < static_cast<qint64>(sizeof(Entry))) {
+        return matches;
+    }
+    // An entry still being appended is left out
+    const auto count = static_cast<std::size_t>(entries.size()) / sizeof(Entry);
+    auto map = entries.map(0, count * sizeof(Entry));
+    if (map == nullptr) {
+        m_error = entries.errorString();
+        return matches;
+    }
+
+    quint16 version = NO_FIRMWARE;
+    if (!query.firmware.isEmpty()) {
+        auto known = m_firmware.find(query.firmware);
+        if (known == m_firmware.end()) {
+            entries.unmap(map);
+            return matches;
+        }
+        version = known->second;
+    }
+
+    const auto table = reinterpret_cast<const Entry*>(map);
+    auto check = [&](const Entry &entry){
+        if ((query.serial != 0 && entry.serial != query.serial) ||
+            (query.wingSerial != 0 && entry.wingSerial != query.wingSerial) ||
+            (version != NO_FIRMWARE && entry.firmware != version) ||
+            (query.approved >= 0 && entry.approved != query.approved) ||
+            entry.timestamp < query.from || entry.timestamp > query.to) {
+            return;
+        }
+        matches.push_back({(entry.file < m_names.size()) ? m_names[entry.file] : QString(), entry});
+    };
+
+    // The merged part through the posting list of the most selective key, the tail by scanning
+    const int posting = (query.serial != 0) ? SERIAL : (query.wingSerial != 0) ? WING : TIME;
+    const qint64 value = (posting == SERIAL) ? query.serial : (posting == WING) ? query.wingSerial : 0;
+    quint64 done = 0;
+    QFile list(m_path + POSTING_NAMES[posting]);
+    if (list.open(QIODevice::ReadOnly) && list.size() >= static_cast<qint64>(sizeof(quint64))) {
+        auto postings = list.map(0, list.size());
+        if (postings != nullptr) {
+            std::memcpy(&done, postings, sizeof(done));
+            done = std::min<quint64>(done, count);
+            const auto first = reinterpret_cast<const quint32*>(postings + sizeof(quint64));
+            const auto last = first + (list.size() - static_cast<qint64>(sizeof(quint64))) / sizeof(quint32);
+            const auto from = std::make_pair(value, query.from);
+            const auto to = std::make_pair(value, query.to);
+            auto it = std::lower_bound(first, last, from, [&](const quint32 i, const std::pair<qint64, qint64> &key){
+                return i < count && postingKey(posting, table[i]) < key;
+            });
+            for (; it != last; ++it) {
+                if (*it >= count) {
+                    continue;
+                }
+                if (to < postingKey(posting, table[*it])) {
+                    break;
+                }
+                check(table[*it]);
+            }
+            list.unmap(postings);
+        }
+    }
+    for (std::size_t i = done; i < count; ++i) {
+        check(table[i]);
+    }
+    entries.unmap(map);
+
+    std::stable_sort(matches.begin(), matches.end(), [](const Match &a, const Match &b){
+        return a.entry.timestamp < b.entry.timestamp;
+    });
+    return matches;
+}
+
+bool PalmIndex::readRow(const QString &filename, const quint64 offset, QByteArray &row)
+{
+    return PalmArchive::readAt(filename, offset, row);
+}
+
+QString PalmIndex::errorString() const
+{
+    return m_error;
+}
+
+void PalmIndex::refresh()
+{
+    QFile files(m_path + "files.txt");
+    if (files.open(QIODevice::ReadOnly) && files.size() > m_filesRead) {
+        files.seek(m_filesRead);
+        while (!files.atEnd()) {
+            auto line = files.readLine();
+            if (!line.endsWith('\n')) {
+                break;
+            }
+            m_filesRead += line.size();
+            auto fields = QString::fromUtf8(line).trimmed().split('|');
+            if (fields.size() < 3) {
+                continue;
+            }
+            auto id = fields[0].toUInt();
+            auto name = fields.mid(2).join('|');
+            if (id >= m_names.size()) {
+                m_names.resize(id + 1);
+            }
+            // A renamed id no longer answers to its old name
+            m_files.erase(m_names[id]);
+            m_names[id] = name;
+            m_files[name] = {id, fields[1].toLongLong()};
+        }
+    }
+
+    QFile firmware(m_path + "firmware.txt");
+    if (firmware.open(QIODevice::ReadOnly) && firmware.size() > m_firmwareRead) {
+        firmware.seek(m_firmwareRead);
+        while (!firmware.atEnd()) {
+            auto line = firmware.readLine();
+            if (!line.endsWith('\n')) {
+                break;
+            }
+            m_firmwareRead += line.size();
+            auto version = QString::fromUtf8(line).trimmed();
+            m_firmware[version] = static_cast<quint16>(m_versions.size());
+            m_versions.push_back(version);
+        }
+    }
+}
+
+bool PalmIndex::lock(QLockFile &guard)
+{
+    if (!guard.tryLock(LOCK_TIMEOUT)) {
+        m_error = QString("Index %1 is locked by another process").arg(m_path);
+        return false;
+    }
+    refresh();
+    return true;
+}
+
+quint64 PalmIndex::covered() const
+{
+    quint64 done = 0;
+    QFile list(m_path + POSTING_NAMES[TIME]);
+    if (list.open(QIODevice::ReadOnly)) {
+        list.read(reinterpret_cast<char*>(&done), sizeof(done));
+    }
+    return done;
+}
+
+bool PalmIndex::appendEntries(const QString &filename, const qint64 size, const std::vector<PalmIndex::Key> &keys)
+{
+    // Rows a concurrent build() indexed while this process waited for the lock are skipped
+    auto &entry = file(filename);
+    std::vector<Key> fresh;
+    for (const auto& key: keys) {
+        if (static_cast<qint64>(key.offset) >= entry.size) {
+            fresh.push_back(key);
+        }
+    }
+    if (fresh.empty()) {
+        return true;
+    }
+
+    // Rows appended but never indexed, a crash between the log and the index append, are read back from the log
+    auto indexed = entry.size;
+    if (indexed == 0) {
+        QFile log(filename);
+        if (log.open(QIODevice::ReadOnly)) {
+            log.readLine();
+            indexed = log.pos();
+        }
+    }
+    if (static_cast<qint64>(fresh.front().offset) != indexed) {
+        auto parsed = entry;
+        fresh.clear();
+        if (!parseRows(filename, parsed, fresh)) {
+            return false;
+        }
+        return writeEntries(filename, parsed.size, fresh);
+    }
+    return writeEntries(filename, size, fresh);
+}
+
+bool PalmIndex::writeEntries(const QString &filename, const qint64 size, const std::vector<PalmIndex::Key> &keys)
+{
+    auto &entry = file(filename);
+    QByteArray data;
+    data.reserve(static_cast<int>(keys.size() * sizeof(Entry)));
+    for (const auto& key: keys) {
+        Entry record = {key.timestamp, key.offset, key.serial, key.wingSerial, entry.id, firmware(key.firmware), key.approved, 0};
+        data.append(reinterpret_cast<const char*>(&record), sizeof(record));
+    }
+
+    QFile entries(m_path + "entries.dat");
+    if (!entries.open(QIODevice::Append) || entries.write(data) != data.size()) {
+        m_error = entries.errorString();
+        return false;
+    }
+    entry.size = size;
+    writeFile(filename, entry);
+    return true;
+}
+
+bool PalmIndex::mergePostings()
+{
+    QFile entries(m_path + "entries.dat");
+    if (!entries.open(QIODevice::ReadOnly)) {
+        return !entries.exists();
+    }
+    const auto count = static_cast<quint64>(entries.size()) / sizeof(Entry);
+    if (count == 0) {
+        return true;
+    }
+    auto map = entries.map(0, static_cast<qint64>(count * sizeof(Entry)));
+    if (map == nullptr) {
+        m_error = entries.errorString();
+        return false;
+    }
+    const auto table = reinterpret_cast<const Entry*>(map);
+
+    // The time list goes last, its count is what decides the next merge
+    bool merged = true;
+    for (int posting = SERIAL; posting < POSTINGS; ++posting) {
+        auto less = [&](const quint32 a, const quint32 b){
+            return postingKey(posting, table[a]) < postingKey(posting, table[b]);
+        };
+
+        quint64 done = 0;
+        std::vector<quint32> list;
+        QFile old(m_path + POSTING_NAMES[posting]);
+        if (old.open(QIODevice::ReadOnly) && old.read(reinterpret_cast<char*>(&done), sizeof(done)) == sizeof(done)) {
+            auto data = old.readAll();
+            list.resize(static_cast<std::size_t>(data.size()) / sizeof(quint32));
+            std::memcpy(list.data(), data.constData(), list.size() * sizeof(quint32));
+        }
+        old.close();
+        list.erase(std::remove_if(list.begin(), list.end(), [&](const quint32 i){ return i >= count; }), list.end());
+        done = std::min(done, count);
+        if (done == count) {
+            continue;
+        }
+
+        std::vector<quint32> tail(count - done);
+        std::iota(tail.begin(), tail.end(), static_cast<quint32>(done));
+        std::stable_sort(tail.begin(), tail.end(), less);
+        std::vector<quint32> all;
+        all.reserve(list.size() + tail.size());
+        std::merge(list.begin(), list.end(), tail.begin(), tail.end(), std::back_inserter(all), less);
+
+        QSaveFile out(m_path + POSTING_NAMES[posting]);
+        if (!out.open(QIODevice::WriteOnly)) {
+            m_error = out.errorString();
+            merged = false;
+            break;
+        }
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        out.write(reinterpret_cast<const char*>(all.data()), static_cast<qint64>(all.size() * sizeof(quint32)));
+        if (!out.commit()) {
+            m_error = out.errorString();
+            merged = false;
+            break;
+        }
+    }
+    entries.unmap(map);
+    return merged;
+}
+
+std::pair<qint64, qint64> PalmIndex::postingKey(const int posting, const PalmIndex::Entry &entry)
+{
+    switch (posting) {
+    case SERIAL:
+        return {entry.serial, entry.timestamp};
+    case WING:
+        return {entry.wingSerial, entry.timestamp};
+    default:
+        return {0, entry.timestamp};
+    }
+}
+
+PalmIndex::File &PalmIndex::file(const QString &filename)
+{
+    auto entry = m_files.find(filename);
+    if (entry != m_files.end()) {
+        return entry->second;
+    }
+    File file = {static_cast<quint32>(m_names.size()), 0};
+    m_names.push_back(filename);
+    writeFile(filename, file);
+    return m_files[filename] = file;
+}
+
+void PalmIndex::writeFile(const QString &filename, const PalmIndex::File &file)
+{
+    // Only written under the lock after refresh(), so this process has read up to the end
+    QFile files(m_path + "files.txt");
+    if (files.open(QIODevice::Append)) {
+        m_filesRead += files.write(QString("%1|%2|%3\n").arg(file.id).arg(file.size).arg(filename).toUtf8());
+    }
+}
+
+quint16 PalmIndex::firmware(const QString &version)
+{
+    if (version.isEmpty()) {
+        return NO_FIRMWARE;
+    }
+    auto known = m_firmware.find(version);
+    if (known != m_firmware.end()) {
+        return known->second;
+    }
+    auto id = static_cast<quint16>(m_versions.size());
+    m_versions.push_back(version);
+    m_firmware[version] = id;
+    QFile firmware(m_path + "firmware.txt");
+    if (firmware.open(QIODevice::Append)) {
+        m_firmwareRead += firmware.write(version.toUtf8() + '\n');
+    }
+    return id;
+}
+
+bool PalmIndex::parseRows(const QString &filename, PalmIndex::File &file, std::vector<PalmIndex::Key> &keys)
+{
+    QFile log(filename);
+    if (!log.open(QIODevice::ReadOnly)) {
+        m_error = log.errorString();
+        return false;
+    }
+    const auto header = QString::fromUtf8(log.readLine()).trimmed().split('|');
+    const auto serial = header.indexOf("SerialNo");
+    const auto wingSerial = header.indexOf("WingSerial");
+    const auto timestamp = header.indexOf("Timestamp");
+    const auto approved = header.indexOf("Approved");
+    const auto version = header.indexOf("FirmwareVersion");
+    if (serial < 0 || timestamp < 0) {
+        m_error = QString("not a PALM log");
+        return false;
+    }
+
+    if (file.size > log.pos()) {
+        log.seek(file.size);
+    }
+    while (!log.atEnd()) {
+        const auto offset = log.pos();
+        auto line = log.readLine();
+        if (!line.endsWith('\n')) {
+            // Torn or still being written, picked up by the next build
+            break;
+        }
+        line.chop(1);
+        auto fields = QString::fromUtf8(line).split('|');
+        auto field = [&](const int column){
+            return (column >= 0 && column < fields.size()) ? fields[column] : QString();
+        };
+        Key key;
+        key.offset = static_cast<quint64>(offset);
+        key.timestamp = QDateTime::fromString(field(timestamp), Qt::ISODate).toMSecsSinceEpoch();
+        key.serial = field(serial).toInt();
+        key.wingSerial = static_cast<qint32>(field(wingSerial).toDouble());
+        key.approved = field(approved).isEmpty() ? -1 : static_cast<qint8>(field(approved).toInt() != 0);
+        key.firmware = field(version);
+        keys.push_back(key);
+        file.size = log.pos();
+    }
+    return true;
+}
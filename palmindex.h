@@ -0,0 +1,119 @@
+#ifndef PALMINDEX_H
+#define PALMINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QFile>
+#include <QLockFile>
+#include <vector>
+#include <map>
+#include <utility>
+#include <limits>
+
+// Row index of the text logs in one directory, kept in <directory>/.palmindex
+//
+//   entries.dat   fixed-width Entry records in append order, memory mapped for queries
+//   serial.idx    entry numbers sorted by serial and time, after a quint64 count of entries covered
+//   wing.idx      the same, sorted by wing serial and time
+//   time.idx      the same, sorted by time
+//   files.txt     id|indexed size|name, the last line of an id wins
+//   firmware.txt  one firmware string per line, the line number is the id
+//   lock          held by the process changing any of the above
+//
+// Queries bisect the posting list of the most selective key and scan only the entries appended
+// since the lists were last merged, which happens once that tail outgrows MERGE_ENTRIES or an
+// eighth of the lists.
+class PalmIndex
+{
+public:
+    struct Key {
+        quint64 offset;                     // [Bytes] Start of the row within the written block
+        qint64 timestamp;                   // [Milliseconds since epoch]
+        qint32 serial;
+        qint32 wingSerial;                  // 0 when no wing was logged
+        qint8 approved;                     // -1 when no verdict was logged
+        QString firmware;
+    };
+    struct Entry {
+        qint64 timestamp;
+        quint64 offset;
+        qint32 serial;
+        qint32 wingSerial;
+        quint32 file;
+        quint16 firmware;
+        qint8 approved;
+        quint8 reserved;
+    };
+    struct Query {
+        qint32 serial = 0;                  // 0 matches any
+        qint32 wingSerial = 0;
+        QString firmware;                   // Empty matches any
+        int approved = -1;                  // -1 matches any
+        qint64 from = 0;
+        qint64 to = std::numeric_limits<qint64>::max();
+    };
+    struct Match {
+        QString file;
+        Entry entry;
+    };
+
+    static const QString DIRECTORY;
+
+    explicit PalmIndex(const QString &directory);
+    bool open();
+    // Entries for rows appended to the log, which has grown to size [Bytes]
+    bool append(const QString &filename, const qint64 size, const std::vector<Key> &keys);
+    // The log was sealed into a segment; its rows keep their offsets there
+    void moved(const QString &from, const QString &to);
+    // Indexes the part of every text log in the directory that is not indexed yet
+    int build(QStringList &report);
+    // Sorts the entries appended since the last merge into the posting lists
+    bool merge();
+    std::vector<Match> query(const Query &query);
+    static bool readRow(const QString &filename, const quint64 offset, QByteArray &row);
+    QString errorString() const;
+
+protected:
+    struct File {
+        quint32 id;
+        qint64 size;
+    };
+    enum Posting {
+        SERIAL,
+        WING,
+        TIME,
+        POSTINGS
+    };
+    // Ids are shared by every process indexing the directory; lines added by others are read first
+    void refresh();
+    bool lock(QLockFile &guard);
+    quint64 covered() const;
+    // Posting lists are ordered by a key value and the time within it
+    static std::pair<qint64, qint64> postingKey(const int posting, const Entry &entry);
+    // Drops rows already indexed and fills a gap before the keys from the log itself
+    bool appendEntries(const QString &filename, const qint64 size, const std::vector<Key> &keys);
+    bool writeEntries(const QString &filename, const qint64 size, const std::vector<Key> &keys);
+    bool mergePostings();
+    File &file(const QString &filename);
+    void writeFile(const QString &filename, const File &file);
+    quint16 firmware(const QString &version);
+    bool parseRows(const QString &filename, File &file, std::vector<Key> &keys);
+
+private:
+    QString m_directory;
+    QString m_path;
+    std::map<QString, File> m_files;
+    std::vector<QString> m_names;
+    std::map<QString, quint16> m_firmware;
+    std::vector<QString> m_versions;
+    qint64 m_filesRead;                     // [Bytes] Of files.txt and firmware.txt seen so far
+    qint64 m_firmwareRead;
+    QString m_error;
+
+    static constexpr quint16 NO_FIRMWARE = 0xffff;
+    static constexpr quint64 MERGE_ENTRIES = 64 * 1024;
+    static constexpr int LOCK_TIMEOUT = 10000;  // [Milliseconds]
+};
+
+#endif // PALMINDEX_H
@@ -0,0 +1,323 @@
+#include "palmreader.h"
+#include "palmarchive.h"
+#include "palmschema.h"
+#include "palmwal.h"
+#include "numberformat.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <thread>
+
+double PalmReader::Mean::value() const
+{
+    return (count > 0) ? sum / count : 0.0;
+}
+
+void PalmReader::Aggregate::merge(const PalmReader::Aggregate &other)
+{
+    rows += other.rows;
+    skipped += other.skipped;
+    for (const auto& entry: other.serials) {
+        auto &serial = serials[entry.first];
+        serial.rows += entry.second.rows;
+        serial.tests += entry.second.tests;
+        serial.failures += entry.second.failures;
+        if (serial.means.size() < entry.second.means.size()) {
+            serial.means.resize(entry.second.means.size());
+        }
+        for (std::size_t i = 0; i < entry.second.means.size(); ++i) {
+            serial.means[i].sum += entry.second.means[i].sum;
+            serial.means[i].count += entry.second.means[i].count;
+        }
+    }
+    for (const auto& entry: other.days) {
+        auto &day = days[entry.first];
+        day.rows += entry.second.rows;
+        day.tests += entry.second.tests;
+        day.failures += entry.second.failures;
+        day.units.insert(entry.second.units.begin(), entry.second.units.end());
+    }
+}
+
+PalmReader::PalmReader()
+    : m_threads(std::max(QThread::idealThreadCount(), 1))
+{
+
+}
+
+void PalmReader::setThreads(const int threads)
+{
+    m_threads = std::max(threads, 1);
+}
+
+bool PalmReader::read(const QStringList &paths)
+{
+    QStringList files;
+    for (const auto& path: paths) {
+        QFileInfo info(path);
+        if (!info.isDir()) {
+            files << path;
+            continue;
+        }
+        // Daily logs and their sealed segments, in-flight side files are skipped
+        QDir dir(path);
+        for (const auto& name: dir.entryList(QStringList() << "*.txt" << "*.txt.*", QDir::Files, QDir::Name)) {
+            if (!name.endsWith(PalmWal::SUFFIX) && !name.endsWith(".part") && !name.endsWith(PalmArchive::SEALING_SUFFIX)) {
+                files << dir.filePath(name);
+            }
+        }
+    }
+
+    auto ok = true;
+    for (const auto& file: files) {
+        ok = readFile(file) && ok;
+    }
+    return ok;
+}
+
+const PalmReader::Aggregate &PalmReader::aggregate() const
+{
+    return m_aggregate;
+}
+
+QStringList PalmReader::errors() const
+{
+    return m_errors;
+}
+
+void PalmReader::writeReport(QTextStream &out) const
+{
+    auto rate = [](const quint64 failures, const quint64 tests){
+        return NumberFormat::toFixed((tests > 0) ? 100.0 * failures / tests : 0.0, 2);
+    };
+
+    out << "Day|Rows|Units|Tests|Failures|FailureRate\n";
+    for (const auto& entry: m_aggregate.days) {
+        const auto &day = entry.second;
+        out << QString("%1-%2-%3")
+               .arg(entry.first / 10000, 4, 10, QChar('0'))
+               .arg(entry.first / 100 % 100, 2, 10, QChar('0'))
+               .arg(entry.first % 100, 2, 10, QChar('0'))
+            << '|' << day.rows << '|' << day.units.size() << '|' << day.tests << '|' << day.failures
+            << '|' << rate(day.failures, day.tests) << '\n';
+    }
+
+    // Columns that never held a number are left out
+    std::vector<std::size_t> numeric;
+    for (std::size_t i = 0; i < m_aggregate.columns.size(); ++i) {
+        auto used = std::any_of(m_aggregate.serials.begin(), m_aggregate.serials.end(), [=](const std::pair<const qint32, Serial> &entry){
+            return i < entry.second.means.size() && entry.second.means[i].count > 0;
+        });
+        if (used) {
+            numeric.push_back(i);
+        }
+    }
+
+    out << "\nSerialNo|Rows|Tests|Failures|FailureRate";
+    for (const auto& column: numeric) {
+        out << '|' << m_aggregate.columns[column];
+    }
+    out << '\n';
+    for (const auto& entry: m_aggregate.serials) {
+        const auto &serial = entry.second;
+        out << entry.first << '|' << serial.rows << '|' << serial.tests << '|' << serial.failures
+            << '|' << rate(serial.failures, serial.tests);
+        for (const auto& column: numeric) {
+            out << '|';
+            if (column < serial.means.size() && serial.means[column].count > 0) {
+                out << NumberFormat::toFixed(serial.means[column].value(), 5);
+            }
+        }
+        out << '\n';
+    }
+    out << QString("\n%1 rows, %2 skipped").arg(m_aggregate.rows).arg(m_aggregate.skipped) << '\n';
+}
+
+bool PalmReader::readFile(const QString &filename)
+{
+    if (filename.endsWith(PalmArchive::SUFFIX)) {
+        QByteArray data;
+        if (!PalmArchive::inflate(filename, data)) {
+            m_errors << QString("%1: not a readable PALM log segment").arg(filename);
+            return false;
+        }
+        parse(data.constData(), data.constData() + data.size());
+        return true;
+    }
+
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_errors << QString("%1: %2").arg(filename).arg(file.errorString());
+        return false;
+    }
+    if (file.size() == 0) {
+        return true;
+    }
+    auto map = file.map(0, file.size());
+    if (map == nullptr) {
+        m_errors << QString("%1: %2").arg(filename).arg(file.errorString());
+        return false;
+    }
+    auto begin = reinterpret_cast<const char*>(map);
+    parse(begin, begin + file.size());
+    file.unmap(map);
+    return true;
+}
+
+void PalmReader::parse(const char *begin, const char *end)
+{
+    auto header = static_cast<const char*>(std::memchr(begin, '\n', static_cast<std::size_t>(end - begin)));
+    if (header == nullptr) {
+        return;
+    }
+    const auto fields = layout(begin, header);
+    if (fields.serial < 0) {
+        m_errors << QString("Not a PALM log header: %1").arg(QString::fromLocal8Bit(begin, static_cast<int>(header - begin)));
+        return;
+    }
+    begin = header + 1;
+
+    // One chunk per worker, each starting on a line boundary
+    const auto size = static_cast<std::size_t>(end - begin);
+    const auto chunks = std::max<std::size_t>(std::min<std::size_t>(static_cast<std::size_t>(m_threads), size / MIN_CHUNK), 1);
+    std::vector<const char*> bounds;
+    bounds.push_back(begin);
+    for (std::size_t i = 1; i < chunks; ++i) {
+        bounds.push_back(lineStart(bounds.back(), end, begin + size * i / chunks));
+    }
+    bounds.push_back(end);
+
+    std::vector<Aggregate> partial(chunks);
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < chunks; ++i) {
+        workers.emplace_back(&PalmReader::parseRange, std::cref(fields), bounds[i], bounds[i + 1], std::ref(partial[i]));
+    }
+    parseRange(fields, bounds[0], bounds[1], partial[0]);
+    for (auto& worker: workers) {
+        worker.join();
+    }
+    for (const auto& aggregate: partial) {
+        m_aggregate.merge(aggregate);
+    }
+}
+
+PalmReader::Layout PalmReader::layout(const char *begin, const char *end)
+{
+    const auto names = QString::fromLocal8Bit(begin, static_cast<int>(end - begin)).split('|');
+    const auto &standard = PalmSchema::standardColumns();
+    Layout layout;
+    for (int i = 0; i < names.size(); ++i) {
+        const auto &name = names[i];
+        layout.columns.push_back(-1);
+        if (name == "SerialNo") {
+            layout.serial = i;
+        } else if (name == "Timestamp") {
+            layout.timestamp = i;
+        } else if (name == "Approved") {
+            layout.approved = i;
+        } else if (std::find(standard.begin(), standard.end(), name) == standard.end()) {
+            // Custom columns are averaged, shared by name across files
+            auto &columns = m_aggregate.columns;
+            auto known = std::find(columns.begin(), columns.end(), name);
+            layout.columns.back() = static_cast<int>(known - columns.begin());
+            if (known == columns.end()) {
+                columns.push_back(name);
+            }
+        }
+    }
+    return layout;
+}
+
+void PalmReader::parseRange(const PalmReader::Layout &layout, const char *begin, const char *end, PalmReader::Aggregate &aggregate)
+{
+    const auto columns = layout.columns.size();
+    std::vector<double> values(columns);
+    std::vector<bool> present(columns);
+    while (begin < end) {
+        auto line = static_cast<const char*>(std::memchr(begin, '\n', static_cast<std::size_t>(end - begin)));
+        if (line == nullptr) {
+            // Torn last line
+            ++aggregate.skipped;
+            break;
+        }
+
+        qint32 serial = 0;
+        auto hasSerial = false;
+        int day = 0;
+        int verdict = -1;
+        std::fill(present.begin(), present.end(), false);
+        std::size_t index = 0;
+        for (auto field = begin; field <= line && index < columns; ++index) {
+            auto next = static_cast<const char*>(std::memchr(field, '|', static_cast<std::size_t>(line - field)));
+            if (next == nullptr) {
+                next = line;
+            }
+            const auto column = static_cast<int>(index);
+            if (field == next) {
+                // Empty field
+            } else if (column == layout.serial) {
+                hasSerial = std::from_chars(field, next, serial).ec == std::errc();
+            } else if (column == layout.timestamp && next - field >= 10) {
+                // yyyy-MM-dd prefix of the ISO timestamp
+                int year = 0, month = 0, date = 0;
+                std::from_chars(field, field + 4, year);
+                std::from_chars(field + 5, field + 7, month);
+                std::from_chars(field + 8, field + 10, date);
+                day = year * 10000 + month * 100 + date;
+            } else if (column == layout.approved) {
+                verdict = (*field == '1' || *field == 't') ? 1 : 0;
+            } else if (layout.columns[index] >= 0) {
+                double value;
+                auto result = std::from_chars(field, next, value);
+                if (result.ec == std::errc() && result.ptr == next) {
+                    values[index] = value;
+                    present[index] = true;
+                }
+            }
+            field = next + 1;
+        }
+        begin = line + 1;
+
+        if (!hasSerial) {
+            ++aggregate.skipped;
+            continue;
+        }
+        ++aggregate.rows;
+        auto &unit = aggregate.serials[serial];
+        ++unit.rows;
+        for (std::size_t i = 0; i < columns; ++i) {
+            if (present[i]) {
+                auto slot = static_cast<std::size_t>(layout.columns[i]);
+                if (unit.means.size() <= slot) {
+                    unit.means.resize(slot + 1);
+                }
+                unit.means[slot].sum += values[i];
+                ++unit.means[slot].count;
+            }
+        }
+        if (verdict >= 0) {
+            ++unit.tests;
+            unit.failures += (verdict == 0) ? 1 : 0;
+        }
+        if (day > 0) {
+            auto &total = aggregate.days[day];
+            ++total.rows;
+            if (verdict >= 0) {
+                ++total.tests;
+                total.failures += (verdict == 0) ? 1 : 0;
+                total.units.insert(serial);
+            }
+        }
+    }
+}
+
+const char *PalmReader::lineStart(const char *begin, const char *end, const char *position)
+{
+    position = std::max(position, begin);
+    auto line = static_cast<const char*>(std::memchr(position, '\n', static_cast<std::size_t>(end - position)));
+    return (line == nullptr) ? end : line + 1;
+}
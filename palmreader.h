@@ -0,0 +1,72 @@
+#ifndef PALMREADER_H
+#define PALMREADER_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QTextStream>
+#include <vector>
+#include <map>
+#include <set>
+
+// Aggregates PALM text logs without materializing rows: files are memory mapped,
+// split on line boundaries and parsed by one worker per core
+class PalmReader
+{
+public:
+    struct Mean {
+        double sum = 0.0;
+        quint64 count = 0;
+        double value() const;
+    };
+    struct Serial {
+        quint64 rows = 0;
+        quint64 tests = 0;                  // Rows carrying a verdict
+        quint64 failures = 0;
+        std::vector<Mean> means;            // Per numeric column, see Aggregate::columns
+    };
+    struct Day {
+        quint64 rows = 0;
+        quint64 tests = 0;
+        quint64 failures = 0;
+        std::set<qint32> units;             // Distinct serials with a verdict
+    };
+    struct Aggregate {
+        std::vector<QString> columns;
+        std::map<qint32, Serial> serials;
+        std::map<int, Day> days;            // yyyymmdd
+        quint64 rows = 0;
+        quint64 skipped = 0;                // Torn or unparsable lines
+        void merge(const Aggregate &other);
+    };
+
+    PalmReader();
+    void setThreads(const int threads);
+    // Text logs, sealed segments and directories holding them
+    bool read(const QStringList &paths);
+    const Aggregate &aggregate() const;
+    QStringList errors() const;
+    void writeReport(QTextStream &out) const;
+
+protected:
+    struct Layout {
+        int serial = -1;
+        int timestamp = -1;
+        int approved = -1;
+        std::vector<int> columns;           // Header field to Aggregate::columns, -1 not averaged
+    };
+    bool readFile(const QString &filename);
+    void parse(const char *begin, const char *end);
+    Layout layout(const char *begin, const char *end);
+    static void parseRange(const Layout &layout, const char *begin, const char *end, Aggregate &aggregate);
+    static const char *lineStart(const char *begin, const char *end, const char *position);
+
+private:
+    int m_threads;
+    Aggregate m_aggregate;
+    QStringList m_errors;
+
+    static const int MIN_CHUNK = 1 << 20;   // [Bytes] Smaller files are not worth a thread each
+};
+
+#endif // PALMREADER_H
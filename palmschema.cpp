@@ -0,0 +1,196 @@
+#include "palmschema.h"
+#include <QDateTime>
+#include "numberformat.h"
+
+PalmSchema::PalmSchema()
+{
+
+}
+
+const std::vector<QString> &PalmSchema::standardColumns()
+{
+    static const std::vector<QString> columns = {
+        "Product",
+        "SerialNo",
+        "Timestamp",
+        "Import configuration",
+        "Source",
+        "User name",
+        "Comment",
+        "ProductFamily",
+        "MACAddress",
+        "FirmwareVersion",
+        "Mode",
+        "SerialNoCard",
+        "HardwareRevision",
+        "TestReport",
+        "SoftwareVersion",
+        "Free",
+    };
+    return columns;
+}
+
+PalmSchema::Column PalmSchema::add(const QString &name, const bool custom)
+{
+    auto existing = m_index.constFind(name);
+    if (existing != m_index.constEnd()) {
+        return existing.value();
+    }
+    auto column = static_cast<Column>(m_names.size());
+    m_names.push_back(name);
+    m_index.insert(name, column);
+    if (custom) {
+        m_custom.push_back(column);
+    }
+    return column;
+}
+
+PalmSchema::Column PalmSchema::column(const QString &name) const
+{
+    return m_index.value(name, INVALID);
+}
+
+int PalmSchema::size() const
+{
+    return static_cast<int>(m_names.size());
+}
+
+const QString &PalmSchema::name(const PalmSchema::Column column) const
+{
+    return m_names[column];
+}
+
+const std::vector<QString> &PalmSchema::names() const
+{
+    return m_names;
+}
+
+const std::vector<PalmSchema::Column> &PalmSchema::customColumns() const
+{
+    return m_custom;
+}
+
+void PalmSchema::set(PalmSchema::Slot &slot, const QVariant &value)
+{
+    switch (value.userType()) {
+    case QMetaType::UnknownType :
+        slot.type = Type::EMPTY;
+        break;
+
+    case QMetaType::Bool :
+        slot.type = Type::BOOL;
+        slot.number = value.toBool();
+        break;
+
+    case QMetaType::Int :
+    case QMetaType::UInt :
+    case QMetaType::Long :
+    case QMetaType::ULong :
+    case QMetaType::LongLong :
+    case QMetaType::ULongLong :
+        slot.type = Type::INT;
+        slot.integer = value.toLongLong();
+        break;
+
+    case QMetaType::Float :
+        slot.type = Type::FLOAT;
+        slot.number = value.toFloat();
+        break;
+
+    case QMetaType::Double :
+        slot.type = Type::DOUBLE;
+        slot.number = value.toDouble();
+        break;
+
+    case QMetaType::QDateTime :
+        slot.type = Type::TIMESTAMP;
+        slot.integer = value.toDateTime().toMSecsSinceEpoch();
+        break;
+
+    default:
+        slot.type = Type::STRING;
+        slot.text = value.toString();
+    }
+}
+
+QVariant PalmSchema::toVariant(const PalmSchema::Slot &slot)
+{
+    switch (slot.type) {
+    case Type::BOOL :
+        return QVariant(slot.number != 0.0);
+    case Type::INT :
+        return QVariant(slot.integer);
+    case Type::FLOAT :
+        return QVariant(static_cast<float>(slot.number));
+    case Type::DOUBLE :
+        return QVariant(slot.number);
+    case Type::TIMESTAMP :
+        return QVariant(QDateTime::fromMSecsSinceEpoch(slot.integer));
+    case Type::STRING :
+        return QVariant(slot.text);
+    default:
+        return QVariant();
+    }
+}
+
+QString PalmSchema::format(const PalmSchema::Slot &slot)
+{
+    switch (slot.type) {
+    case Type::STRING :
+        return slot.text;
+    case Type::EMPTY :
+        return QString();
+    default: {
+        QByteArray text;
+        append(text, slot);
+        return QString::fromLatin1(text);
+    }
+    }
+}
+
+void PalmSchema::append(QByteArray &out, const PalmSchema::Slot &slot)
+{
+    switch (slot.type) {
+    case Type::BOOL :
+        out.append((slot.number != 0.0) ? '1' : '0');
+        break;
+
+    case Type::INT :
+        NumberFormat::appendInteger(out, slot.integer);
+        break;
+
+    case Type::FLOAT :
+    case Type::DOUBLE :
+        NumberFormat::appendFixed(out, slot.number, FORMAT_DECIMALS);
+        break;
+
+    case Type::TIMESTAMP : {
+        // yyyy-MM-ddThh:mm:ss
+        const auto time = QDateTime::fromMSecsSinceEpoch(slot.integer);
+        const int fields[] = {time.date().year(), time.date().month(), time.date().day(),
+                              time.time().hour(), time.time().minute(), time.time().second()};
+        const char separators[] = {'-', '-', 'T', ':', ':', '\0'};
+        char buffer[NumberFormat::BUFFER_SIZE];
+        int length = 0;
+        for (int i = 0; i < 6; ++i) {
+            if (i > 0) {
+                buffer[length++] = separators[i - 1];
+            }
+            auto width = (i == 0) ? 4 : 2;
+            for (int digit = width - 1, field = fields[i]; digit >= 0; --digit, field /= 10) {
+                buffer[length + digit] = static_cast<char>('0' + field % 10);
+            }
+            length += width;
+        }
+        out.append(buffer, length);
+        break;
+    }
+
+    case Type::STRING :
+        out.append(slot.text.toLocal8Bit());
+        break;
+
+    default:
+        break;
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef PALMSCHEMA_H
+#define PALMSCHEMA_H
+
+#include <QString>
+#include <QVariant>
+#include <QHash>
+#include <vector>
+
+// Column layout of a PALM log, resolved once so rows are written by index
+class PalmSchema
+{
+public:
+    typedef int Column;
+    static constexpr Column INVALID = -1;
+
+    enum class Type : quint8 {
+        EMPTY,
+        BOOL,
+        INT,
+        FLOAT,
+        DOUBLE,
+        TIMESTAMP,                          // [Milliseconds since epoch]
+        STRING,
+    };
+    struct Slot {
+        Type type = Type::EMPTY;
+        double number = 0.0;                // BOOL, FLOAT and DOUBLE
+        qint64 integer = 0;                 // INT and TIMESTAMP
+        QString text;                       // STRING
+    };
+    typedef std::vector<Slot> Row;
+
+    PalmSchema();
+    // Returns the existing handle when the name is already a column
+    Column add(const QString &name, const bool custom);
+    Column column(const QString &name) const;
+    int size() const;
+    const QString &name(const Column column) const;
+    const std::vector<QString> &names() const;
+    const std::vector<Column> &customColumns() const;
+    // Columns every PALM log starts with, custom columns follow
+    static const std::vector<QString> &standardColumns();
+
+    static void set(Slot &slot, const QVariant &value);
+    static QVariant toVariant(const Slot &slot);
+    static QString format(const Slot &slot);
+    // Appends the text form of the slot, numbers are written without temporary strings
+    static void append(QByteArray &out, const Slot &slot);
+
+private:
+    std::vector<QString> m_names;
+    std::vector<Column> m_custom;
+    QHash<QString, Column> m_index;
+
+    static constexpr int FORMAT_DECIMALS = 5;
+};
+
+#endif // PALMSCHEMA_H
@@ -0,0 +1,169 @@
+#include "palmwal.h"
+#include <QDataStream>
+#include <QDir>
+#include <QStringList>
+#include <array>
+#include <algorithm>
+#include <unistd.h>
+
+const QString PalmWal::SUFFIX = QString(".wal");
+
+
+bool PalmWal::append(QFile &log, const std::vector<QByteArray> &payloads, QString &error)
+{
+    QFile wal(log.fileName() + SUFFIX);
+    if (!wal.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        error = wal.errorString();
+        return false;
+    }
+    QDataStream stream(&wal);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << MAGIC << static_cast<qint64>(log.size());
+    QByteArray data;
+    for (const auto& payload: payloads) {
+        stream << FRAME_MAGIC << static_cast<quint32>(payload.size()) << crc32(payload);
+        stream.writeRawData(payload.constData(), payload.size());
+        data.append(payload);
+    }
+    // The segment is durable before the log is touched, the log is durable before the segment goes
+    if (stream.status() != QDataStream::Ok || !sync(wal)) {
+        error = wal.errorString();
+        wal.close();
+        wal.remove();
+        return false;
+    }
+    wal.close();
+
+    if (log.write(data) != data.size() || !sync(log)) {
+        error = log.errorString();
+        return false;
+    }
+    return QFile::remove(wal.fileName());
+}
+
+bool PalmWal::recover(const QString &filename, QString &report)
+{
+    QFile log(filename);
+    QFile wal(filename + SUFFIX);
+    if (!wal.exists()) {
+        // No append was in flight; a crash without the segment can still leave half a line
+        if (!log.exists() || log.size() == 0 || !log.open(QIODevice::ReadWrite)) {
+            return true;
+        }
+        qint64 end = log.size();
+        const qint64 window = 4096;
+        while (end > 0) {
+            auto start = std::max<qint64>(0, end - window);
+            log.seek(start);
+            auto tail = log.read(end - start);
+            auto newline = tail.lastIndexOf('\n');
+            if (newline >= 0) {
+                end = start + newline + 1;
+                break;
+            }
+            end = start;
+        }
+        if (end == log.size()) {
+            return true;
+        }
+        report = QString("%1: cut %2 bytes of a torn line").arg(filename).arg(log.size() - end);
+        return log.resize(end) && sync(log);
+    }
+
+    if (!wal.open(QIODevice::ReadOnly)) {
+        report = QString("%1: %2").arg(wal.fileName()).arg(wal.errorString());
+        return false;
+    }
+    QDataStream stream(&wal);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    quint32 magic = 0;
+    qint64 offset = -1;
+    stream >> magic >> offset;
+    const bool header = (stream.status() == QDataStream::Ok && magic == MAGIC);
+    bool complete = header;
+    std::vector<QByteArray> payloads;
+    while (complete && !wal.atEnd()) {
+        quint32 frame, length, crc;
+        stream >> frame >> length >> crc;
+        complete = stream.status() == QDataStream::Ok && frame == FRAME_MAGIC && length <= wal.size();
+        if (!complete) {
+            break;
+        }
+        QByteArray payload(static_cast<int>(length), Qt::Uninitialized);
+        complete = stream.readRawData(payload.data(), payload.size()) == payload.size() && crc32(payload) == crc;
+        payloads.push_back(payload);
+    }
+    wal.close();
+
+    // A segment cut short was never applied to the log; only a complete one is replayed
+    if (!log.open(QIODevice::ReadWrite)) {
+        report = QString("%1: %2").arg(filename).arg(log.errorString());
+        return false;
+    }
+    // On any failure the segment is kept, so the next recovery can still redo the batch
+    if (header && offset >= 0 && offset <= log.size() && !log.resize(offset)) {
+        report = QString("%1: %2").arg(filename).arg(log.errorString());
+        return false;
+    }
+    log.seek(log.size());
+    int replayed = 0;
+    if (complete) {
+        for (const auto& payload: payloads) {
+            if (log.write(payload) != payload.size()) {
+                report = QString("%1: %2").arg(filename).arg(log.errorString());
+                return false;
+            }
+            ++replayed;
+        }
+    }
+    if (!sync(log)) {
+        report = QString("%1: %2").arg(filename).arg(log.errorString());
+        return false;
+    }
+    report = QString("%1: replayed %2 records from the write-ahead segment").arg(filename).arg(replayed);
+    return QFile::remove(wal.fileName());
+}
+
+int PalmWal::recoverDirectory(const QString &directory, QStringList &reports)
+{
+    int recovered = 0;
+    QDir dir(directory);
+    for (const auto& entry: dir.entryList(QStringList() << "*" + SUFFIX, QDir::Files)) {
+        auto filename = dir.absoluteFilePath(entry);
+        filename.chop(SUFFIX.size());
+        QString report;
+        if (!recover(filename, report)) {
+            reports << QString("Could not recover %1").arg(report);
+            continue;
+        }
+        reports << report;
+        ++recovered;
+    }
+    return recovered;
+}
+
+quint32 PalmWal::crc32(const QByteArray &data)
+{
+    static const auto table = [](){
+        std::array<quint32, 256> table;
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : (c >> 1);
+            }
+            table[i] = c;
+        }
+        return table;
+    }();
+
+    quint32 crc = 0xffffffff;
+    for (const auto byte: data) {
+        crc = table[(crc ^ static_cast<quint8>(byte)) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffff;
+}
+
+bool PalmWal::sync(QFile &file)
+{
+    return file.flush() && ::fsync(file.handle()) == 0;
+}
@@ -0,0 +1,34 @@
+#ifndef PALMWAL_H
+#define PALMWAL_H
+
+#include <QString>
+#include <QByteArray>
+#include <QStringList>
+#include <QFile>
+#include <vector>
+
+// Write-ahead segment that makes a text log append all-or-nothing
+//
+//   wal   := MAGIC offset frame*           offset is the log size before the append
+//   frame := FRAME_MAGIC length crc32 payload
+class PalmWal
+{
+public:
+    static const QString SUFFIX;
+
+    // Appends the payloads to the open log through the write-ahead segment
+    static bool append(QFile &log, const std::vector<QByteArray> &payloads, QString &error);
+    // Finishes or rolls back an interrupted append and cuts a torn last line; returns false on failure
+    static bool recover(const QString &filename, QString &report);
+    // Recovers every log in the directory that has a write-ahead segment left behind
+    static int recoverDirectory(const QString &directory, QStringList &reports);
+    static quint32 crc32(const QByteArray &data);
+
+private:
+    static bool sync(QFile &file);
+
+    static const quint32 MAGIC = 0x4c415750;         // "PWAL"
+    static const quint32 FRAME_MAGIC = 0x4d415246;   // "FRAM"
+};
+
+#endif // PALMWAL_H
@@ -0,0 +1,315 @@
+#include "palmwriter.h"
+#include "palmarchive.h"
+#include "palmwal.h"
+#include <QFileInfo>
+#include <QDir>
+#include <algorithm>
+#include <unistd.h>
+
+PalmWriter &PalmWriter::instance()
+{
+    static PalmWriter writer;
+    return writer;
+}
+
+PalmWriter::PalmWriter(QObject *parent)
+    : QThread(parent)
+    , m_queue(QUEUE_SIZE)
+    , m_stopping(false)
+    , m_accepted(0)
+    , m_written(0)
+    , m_waits(0)
+    , m_drops(0)
+    , m_pending(false)
+{
+
+}
+
+PalmWriter::~PalmWriter()
+{
+    stop();
+}
+
+bool PalmWriter::submit(PalmWriter::Record &record)
+{
+    if (!isRunning()) {
+        m_stopping = false;
+        start();
+    }
+
+    QElapsedTimer waited;
+    if (!m_queue.push(record)) {
+        // Backpressure: the producer sleeps until the writer drains the queue, without spinning
+        waited.start();
+        ++m_waits;
+        QMutexLocker locker(&m_mutex);
+        while (!m_queue.push(record)) {
+            auto left = BACKPRESSURE_TIMEOUT - waited.elapsed();
+            if (left <= 0) {
+                locker.unlock();
+                ++m_drops;
+                emit congested(m_waits, m_drops);
+                m_reported.start();
+                return false;
+            }
+            m_pending = true;
+            m_wake.wakeOne();
+            m_drained.wait(&m_mutex, static_cast<unsigned long>(left));
+        }
+    }
+    ++m_accepted;
+    wake();
+
+    if (waited.isValid() && (!m_reported.isValid() || m_reported.elapsed() > REPORT_INTERVAL)) {
+        emit congested(m_waits, m_drops);
+        m_reported.start();
+    }
+    return true;
+}
+
+bool PalmWriter::flush(const int timeout)
+{
+    const quint64 target = m_accepted;
+    QElapsedTimer timer;
+    timer.start();
+    QMutexLocker locker(&m_mutex);
+    while (m_written < target) {
+        auto left = timeout - timer.elapsed();
+        if (!isRunning() || left <= 0) {
+            return false;
+        }
+        m_pending = true;
+        m_wake.wakeOne();
+        m_drained.wait(&m_mutex, static_cast<unsigned long>(left));
+    }
+    return true;
+}
+
+void PalmWriter::stop()
+{
+    if (!isRunning()) {
+        return;
+    }
+    m_stopping = true;
+    wake();
+    wait();
+}
+
+quint64 PalmWriter::waits() const
+{
+    return m_waits;
+}
+
+quint64 PalmWriter::drops() const
+{
+    return m_drops;
+}
+
+void PalmWriter::run()
+{
+    std::vector<Record> batch;
+    Record record;
+    while (true) {
+        // Everything queued since the last pass is committed together
+        while (m_queue.pop(record)) {
+            batch.push_back(std::move(record));
+        }
+        if (!batch.empty()) {
+            m_mutex.lock();
+            m_drained.wakeAll();
+            m_mutex.unlock();
+
+            commit(batch);
+
+            m_mutex.lock();
+            m_written += batch.size();
+            m_drained.wakeAll();
+            m_mutex.unlock();
+            batch.clear();
+            continue;
+        }
+        closeIdle();
+        if (m_stopping) {
+            break;
+        }
+        // A push signalled after the queue was found empty is seen through m_pending, never lost
+        m_mutex.lock();
+        if (!m_pending && !m_stopping) {
+            m_wake.wait(&m_mutex, IDLE_WAIT);
+        }
+        m_pending = false;
+        m_mutex.unlock();
+    }
+    m_files.clear();
+    m_indexes.clear();
+}
+
+void PalmWriter::commit(std::vector<PalmWriter::Record> &batch)
+{
+    std::map<QString, std::vector<const Record*>> groups;
+    for (const auto& record: batch) {
+        groups[record.filename].push_back(&record);
+    }
+
+    for (const auto& group: groups) {
+        const auto &last = *group.second.back();
+        auto empty = std::all_of(group.second.begin(), group.second.end(), [](const Record *record){
+            return record->rows.isEmpty();
+        });
+        if (empty) {
+            // A seal on its own must not create a header-only file
+            if (last.seal && QFile::exists(group.first)) {
+                // Files of an earlier run may still have a write-ahead segment to finish
+                if (m_files.count(group.first) == 0) {
+                    QString report;
+                    if (!PalmWal::recover(group.first, report)) {
+                        emit error(QString("Could not recover %1").arg(report));
+                    } else if (!report.isEmpty()) {
+                        emit recovered(report);
+                    }
+                }
+                seal(group.first, last.compress);
+            }
+            continue;
+        }
+
+        auto handle = file(group.first);
+        if (handle == nullptr) {
+            emit error(QString("Could not open log %1, %2 rows lost").arg(group.first).arg(group.second.size()));
+            continue;
+        }
+
+        std::vector<QByteArray> payloads;
+        bool sync = false;
+        bool sealed = false;
+        bool atomic = false;
+        auto base = static_cast<quint64>(handle->size());
+        if (handle->size() == 0) {
+            payloads.push_back(group.second.front()->header);
+            base += static_cast<quint64>(group.second.front()->header.size());
+        }
+        std::vector<PalmIndex::Key> keys;
+        for (const auto record: group.second) {
+            if (!record->rows.isEmpty()) {
+                payloads.push_back(record->rows);
+            }
+            for (auto key: record->keys) {
+                key.offset += base;
+                keys.push_back(key);
+            }
+            base += static_cast<quint64>(record->rows.size());
+            sync = sync || record->sync;
+            sealed = sealed || record->seal;
+            atomic = atomic || record->atomic;
+        }
+
+        QString message;
+        if (atomic) {
+            if (!PalmWal::append(*handle, payloads, message)) {
+                emit error(QString("Could not commit log %1: %2").arg(group.first).arg(message));
+                m_files.erase(group.first);
+                continue;
+            }
+        } else {
+            QByteArray data;
+            for (const auto& payload: payloads) {
+                data.append(payload);
+            }
+            if (handle->write(data) != data.size() || !handle->flush()) {
+                emit error(QString("Could not write log %1: %2").arg(group.first).arg(handle->errorString()));
+                m_files.erase(group.first);
+                continue;
+            }
+            if (sync) {
+                ::fsync(handle->handle());
+            }
+        }
+
+        if (!keys.empty()) {
+            auto rows = index(group.first);
+            if (rows == nullptr || !rows->append(group.first, handle->size(), keys)) {
+                emit error(QString("Could not index log %1").arg(group.first));
+            }
+        }
+
+        if (sealed || (last.rotateSize > 0 && handle->size() >= last.rotateSize)) {
+            seal(group.first, last.compress);
+        }
+    }
+}
+
+QFile *PalmWriter::file(const QString &filename)
+{
+    auto &handle = m_files[filename];
+    if (!handle.file) {
+        // First touch of the file by this process; finish whatever a crash left behind
+        QString report;
+        if (!PalmWal::recover(filename, report)) {
+            emit error(QString("Could not recover %1").arg(report));
+        } else if (!report.isEmpty()) {
+            emit recovered(report);
+        }
+        handle.file.reset(new QFile(filename));
+        if (!handle.file->open(QIODevice::Append | QIODevice::Text)) {
+            m_files.erase(filename);
+            return nullptr;
+        }
+    }
+    handle.used.start();
+    return handle.file.get();
+}
+
+void PalmWriter::closeIdle()
+{
+    for (auto it = m_files.begin(); it != m_files.end(); ) {
+        if (it->second.used.elapsed() > FILE_IDLE) {
+            it = m_files.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void PalmWriter::seal(const QString &filename, const bool compress)
+{
+    m_files.erase(filename);
+    if (QFileInfo(filename).size() == 0) {
+        QFile::remove(filename);
+        return;
+    }
+    QString target;
+    if (!PalmArchive::seal(filename, filename, compress, target)) {
+        emit error(QString("Could not seal log %1").arg(filename));
+        return;
+    }
+    // Indexed rows keep their offsets in the segment, only the file name changes
+    auto directory = QFileInfo(filename).absolutePath();
+    if (m_indexes.count(directory) > 0 || QFileInfo::exists(QDir(directory).filePath(PalmIndex::DIRECTORY))) {
+        auto rows = index(filename);
+        if (rows != nullptr) {
+            rows->moved(filename, target);
+        }
+    }
+}
+
+void PalmWriter::wake()
+{
+    QMutexLocker locker(&m_mutex);
+    m_pending = true;
+    m_wake.wakeOne();
+}
+
+PalmIndex *PalmWriter::index(const QString &filename)
+{
+    auto directory = QFileInfo(filename).absolutePath();
+    auto &index = m_indexes[directory];
+    if (!index) {
+        index.reset(new PalmIndex(directory));
+        if (!index->open()) {
+            emit error(index->errorString());
+            m_indexes.erase(directory);
+            return nullptr;
+        }
+    }
+    return index.get();
+}
@@ -0,0 +1,85 @@
+#ifndef PALMWRITER_H
+#define PALMWRITER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QFile>
+#include <atomic>
+#include <map>
+#include <memory>
+#include "boundedqueue.h"
+#include "palmindex.h"
+
+// Writes PALM rows on a background thread so slow log storage never stalls the GUI
+class PalmWriter : public QThread
+{
+    Q_OBJECT
+public:
+    struct Record {
+        QString filename;
+        QByteArray header;                  // Written first when the file is empty
+        QByteArray rows;
+        bool sync = false;                  // fsync before the batch is reported done
+        qint64 rotateSize = 0;              // [Bytes] Seal the file into a segment beyond this, 0 never
+        bool compress = false;              // Sealed segments are compressed, see PalmArchive
+        bool seal = false;                  // Seal the file after these rows, the day is over
+        bool atomic = false;                // All-or-nothing append through a write-ahead segment
+        std::vector<PalmIndex::Key> keys;   // Rows to index, offsets relative to rows
+    };
+
+    static PalmWriter &instance();
+    ~PalmWriter();
+    // Waits at most BACKPRESSURE_TIMEOUT for room in a full queue, then drops the record
+    bool submit(Record &record);
+    // Blocks until every accepted record is on disk, or the timeout passes
+    bool flush(const int timeout = FLUSH_TIMEOUT);
+    void stop();
+    quint64 waits() const;
+    quint64 drops() const;
+
+signals:
+    void congested(const quint64 waits, const quint64 drops);
+    void error(const QString &message);
+    void recovered(const QString &report);
+
+protected:
+    explicit PalmWriter(QObject *parent = nullptr);
+    void run() override;
+    void commit(std::vector<Record> &batch);
+    QFile *file(const QString &filename);
+    void closeIdle();
+    void seal(const QString &filename, const bool compress);
+    PalmIndex *index(const QString &filename);
+    void wake();
+
+private:
+    BoundedQueue<Record> m_queue;
+    std::atomic<bool> m_stopping;
+    std::atomic<quint64> m_accepted;
+    std::atomic<quint64> m_written;
+    quint64 m_waits;
+    quint64 m_drops;
+    QElapsedTimer m_reported;
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    QWaitCondition m_drained;                       // Records were taken off the queue or written
+    bool m_pending;                                 // Work signalled since the writer last looked, under m_mutex
+
+    struct Handle {
+        std::unique_ptr<QFile> file;
+        QElapsedTimer used;
+    };
+    std::map<QString, Handle> m_files;
+    std::map<QString, std::unique_ptr<PalmIndex>> m_indexes;
+
+    static const int QUEUE_SIZE = 1024;
+    static const int FLUSH_TIMEOUT = 5000;          // [Milliseconds]
+    static const int BACKPRESSURE_TIMEOUT = 200;    // [Milliseconds] Producer wait before a row is dropped
+    static const int REPORT_INTERVAL = 10000;       // [Milliseconds]
+    static const int IDLE_WAIT = 100;               // [Milliseconds]
+    static const int FILE_IDLE = 60000;             // [Milliseconds] Handles are closed after this
+};
+
+#endif // PALMWRITER_H
@@ -0,0 +1,93 @@
+#include "settledetector.h"
+#include <cmath>
+
+SettleDetector::SettleDetector()
+    : m_window(1.0)
+    , m_maxSlope(0.0)
+    , m_maxDeviation(0.0)
+{
+    reset();
+}
+
+void SettleDetector::setWindow(const double window)
+{
+    m_window = window;
+}
+
+void SettleDetector::setSlope(const double slope)
+{
+    m_maxSlope = slope;
+}
+
+void SettleDetector::setDeviation(const double deviation)
+{
+    m_maxDeviation = deviation;
+}
+
+void SettleDetector::reset()
+{
+    m_samples.clear();
+    m_sumT = 0.0;
+    m_sumV = 0.0;
+    m_sumTT = 0.0;
+    m_sumTV = 0.0;
+    m_sumVV = 0.0;
+    m_firstTime = NAN;
+}
+
+void SettleDetector::addData(const double time, const double value)
+{
+    if (std::isnan(m_firstTime)) {
+        m_firstTime = time;
+    }
+    // Sums are kept relative to the first sample to stay well conditioned
+    auto t = time - m_firstTime;
+    m_samples.push_back(std::make_pair(t, value));
+    m_sumT += t;
+    m_sumV += value;
+    m_sumTT += t * t;
+    m_sumTV += t * value;
+    m_sumVV += value * value;
+
+    while (!m_samples.empty() && m_samples.front().first <= t - m_window) {
+        auto removed = m_samples.front();
+        m_samples.pop_front();
+        m_sumT -= removed.first;
+        m_sumV -= removed.second;
+        m_sumTT -= removed.first * removed.first;
+        m_sumTV -= removed.first * removed.second;
+        m_sumVV -= removed.second * removed.second;
+    }
+}
+
+bool SettleDetector::isSettled() const
+{
+    if (static_cast<int>(m_samples.size()) < MIN_SAMPLES) {
+        return false;
+    }
+    if (m_samples.back().first < m_window) {
+        return false;
+    }
+    return std::abs(slope()) <= m_maxSlope && deviation() <= m_maxDeviation;
+}
+
+double SettleDetector::slope() const
+{
+    auto n = static_cast<double>(m_samples.size());
+    auto denominator = n * m_sumTT - m_sumT * m_sumT;
+    if (m_samples.size() < 2 || denominator <= 0.0) {
+        return 0.0;
+    }
+    return (n * m_sumTV - m_sumT * m_sumV) / denominator;
+}
+
+double SettleDetector::deviation() const
+{
+    if (m_samples.empty()) {
+        return 0.0;
+    }
+    auto n = static_cast<double>(m_samples.size());
+    auto mean = m_sumV / n;
+    auto variance = m_sumVV / n - mean * mean;
+    return (variance > 0.0) ? std::sqrt(variance) : 0.0;
+}
@@ -0,0 +1,38 @@
+#ifndef SETTLEDETECTOR_H
+#define SETTLEDETECTOR_H
+
+#include <deque>
+#include <utility>
+
+class SettleDetector
+{
+public:
+    SettleDetector();
+
+    void setWindow(const double window);
+    void setSlope(const double slope);
+    void setDeviation(const double deviation);
+    void reset();
+
+    void addData(const double time, const double value);
+    bool isSettled() const;
+    double slope() const;
+    double deviation() const;
+
+private:
+    double m_window;                    // [Seconds]
+    double m_maxSlope;                  // [Units per second]
+    double m_maxDeviation;              // [Units]
+
+    std::deque<std::pair<double, double>> m_samples;
+    double m_sumT;
+    double m_sumV;
+    double m_sumTT;
+    double m_sumTV;
+    double m_sumVV;
+    double m_firstTime;
+
+    static const int MIN_SAMPLES = 3;
+};
+
+#endif // SETTLEDETECTOR_H
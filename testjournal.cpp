@@ -0,0 +1,59 @@
+#include "testjournal.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+
+TestJournal::TestJournal()
+{
+
+}
+
+void TestJournal::setFile(const QString &filename)
+{
+    m_filename = filename;
+    if (!m_filename.isEmpty()) {
+        QDir().mkpath(QFileInfo(m_filename).absolutePath());
+    }
+}
+
+bool TestJournal::isEnabled() const
+{
+    return !m_filename.isEmpty();
+}
+
+bool TestJournal::write(const QJsonObject &checkpoint)
+{
+    if (!isEnabled()) {
+        return false;
+    }
+    // QSaveFile writes aside and renames on commit, so a crash leaves the previous checkpoint intact
+    QSaveFile file(m_filename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(checkpoint).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+bool TestJournal::read(QJsonObject &checkpoint) const
+{
+    QFile file(m_filename);
+    if (!isEnabled() || !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    auto document = QJsonDocument::fromJson(file.readAll());
+    if (!document.isObject()) {
+        return false;
+    }
+    checkpoint = document.object();
+    return true;
+}
+
+void TestJournal::clear()
+{
+    if (isEnabled()) {
+        QFile::remove(m_filename);
+    }
+}
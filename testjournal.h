@@ -0,0 +1,21 @@
+#ifndef TESTJOURNAL_H
+#define TESTJOURNAL_H
+
+#include <QString>
+#include <QJsonObject>
+
+class TestJournal
+{
+public:
+    TestJournal();
+    void setFile(const QString &filename);
+    bool isEnabled() const;
+    bool write(const QJsonObject &checkpoint);
+    bool read(QJsonObject &checkpoint) const;
+    void clear();
+
+private:
+    QString m_filename;
+};
+
+#endif // TESTJOURNAL_H
@@ -0,0 +1,288 @@
+#include "testplan.h"
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonArray>
+
+const QString TestPlan::BUILTIN = ":/testplans/eB-WCB_001.json";
+
+TestPlan::TestPlan()
+    : m_title("Untitled")
+    , m_path("~")
+{
+
+}
+
+bool TestPlan::load(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fail(QString("Could not open test plan [%1]").arg(filename));
+    }
+    return parse(file.readAll());
+}
+
+bool TestPlan::parse(const QByteArray &json)
+{
+    QJsonParseError status;
+    auto document = QJsonDocument::fromJson(json, &status);
+    if (status.error != QJsonParseError::NoError) {
+        return fail(QString("Test plan is not valid JSON (%1)").arg(status.errorString()));
+    }
+    if (!document.isObject()) {
+        return fail(QString("Test plan must be a JSON object"));
+    }
+    auto root = document.object();
+
+    m_version = root.value("version").toString();
+    m_title = root.value("title").toString(m_title);
+    m_path = root.value("path").toString(m_path);
+    m_product = root.value("product").toString();
+    m_productFamily = root.value("productFamily").toString();
+
+    m_columns.clear();
+    for (const auto& column: root.value("columns").toArray()) {
+        m_columns.push_back(column.toString());
+    }
+
+    m_phases.clear();
+    for (const auto& value: root.value("phases").toArray()) {
+        Phase phase;
+        if (!parsePhase(value.toObject(), phase)) {
+            return false;
+        }
+        m_phases.push_back(phase);
+    }
+    if (m_phases.empty()) {
+        return fail(QString("Test plan has no phases"));
+    }
+
+    m_records.clear();
+    for (const auto& value: root.value("record").toArray()) {
+        Record record;
+        if (!parseRecord(value.toObject(), record)) {
+            return false;
+        }
+        m_records.push_back(record);
+    }
+    m_error.clear();
+    return true;
+}
+
+const QString &TestPlan::errorString() const
+{
+    return m_error;
+}
+
+const QString &TestPlan::version() const
+{
+    return m_version;
+}
+
+const QString &TestPlan::title() const
+{
+    return m_title;
+}
+
+const QString &TestPlan::path() const
+{
+    return m_path;
+}
+
+void TestPlan::setPath(const QString &path)
+{
+    m_path = path;
+}
+
+const QString &TestPlan::product() const
+{
+    return m_product;
+}
+
+const QString &TestPlan::productFamily() const
+{
+    return m_productFamily;
+}
+
+const std::vector<QString> &TestPlan::columns() const
+{
+    return m_columns;
+}
+
+const std::vector<TestPlan::Phase> &TestPlan::phases() const
+{
+    return m_phases;
+}
+
+const std::vector<TestPlan::Record> &TestPlan::records() const
+{
+    return m_records;
+}
+
+double TestPlan::value(const WingSlot::Stats &stats, const TestPlan::Field field)
+{
+    switch (field) {
+    case Field::ISUPPLY :           return stats.iSupply;
+    case Field::ISUPPLY_WING :      return stats.iSupplyWing;
+    case Field::SLOT_LQI :          return stats.LQI;
+    case Field::SLOT_LOSS :         return stats.loss;
+    case Field::SLOT_TEMPERATURE :  return stats.temperature;
+    case Field::WING_SERIAL :       return stats.wing.serial;
+    case Field::WING_LQI :          return stats.wing.LQI;
+    case Field::WING_LOSS :         return stats.wing.loss;
+    case Field::WING_HUMIDITY :     return stats.wing.humidity;
+    case Field::WING_TEMPERATURE :  return stats.wing.temperature;
+    case Field::WING_BAT_CAPACITY : return stats.wing.batCapacity;
+    case Field::WING_BAT_VOLT :     return stats.wing.batVolt;
+    case Field::WING_BAT_CURRENT :  return stats.wing.batCurrent;
+    }
+    return 0.0;
+}
+
+bool TestPlan::isWingField(const TestPlan::Field field)
+{
+    return field >= Field::WING_SERIAL;
+}
+
+bool TestPlan::parsePhase(const QJsonObject &object, TestPlan::Phase &phase)
+{
+    phase.name = object.value("name").toString();
+    phase.state = object.value("state").toString();
+    if (phase.state.isEmpty()) {
+        return fail(QString("Phase [%1] has no state").arg(phase.name));
+    }
+
+    auto charge = object.value("charge");
+    phase.charge = charge.isBool() ? (charge.toBool() ? Charge::ON : Charge::OFF) : Charge::KEEP;
+    phase.pair = object.value("pair").toBool(false);
+    phase.requireWing = object.value("requireWing").toBool(false);
+
+    auto until = object.value("until").toString("duration");
+    if (until == "duration") {
+        phase.completion = Completion::DURATION;
+    } else if (until == "paired") {
+        phase.completion = Completion::PAIRED;
+    } else {
+        return fail(QString("Phase [%1] has unknown completion [%2]").arg(phase.name).arg(until));
+    }
+
+    auto duration = object.value("duration");
+    if (duration.isString()) {
+        phase.durationKey = duration.toString();
+        phase.duration = 0;
+    } else if (duration.isDouble()) {
+        phase.duration = duration.toInt();
+    } else {
+        return fail(QString("Phase [%1] has no duration").arg(phase.name));
+    }
+
+    if (!parseSettle(object.value("settle").toObject(), phase.settle)) {
+        return false;
+    }
+    phase.durationColumn = object.value("durationColumn").toString();
+    phase.elapsedColumn = object.value("elapsedColumn").toString();
+    phase.timeoutMessage = object.value("timeoutMessage").toString();
+
+    for (const auto& value: object.value("measure").toArray()) {
+        Measurement measurement;
+        if (!parseMeasurement(value.toObject(), measurement)) {
+            return false;
+        }
+        phase.measurements.push_back(measurement);
+    }
+    for (const auto& value: object.value("record").toArray()) {
+        Record record;
+        if (!parseRecord(value.toObject(), record)) {
+            return false;
+        }
+        phase.records.push_back(record);
+    }
+    return true;
+}
+
+bool TestPlan::parseSettle(const QJsonObject &object, TestPlan::Settle &settle)
+{
+    // "delay" is the key plans have always used, "maxDelay" is accepted as its alias
+    if (object.contains("delay") && object.contains("maxDelay")) {
+        return fail(QString("Settle has both delay and maxDelay"));
+    }
+    settle.maxDelay = object.value(object.contains("maxDelay") ? "maxDelay" : "delay").toInt(0);
+    settle.detect = object.contains("field");
+    settle.field = Field::ISUPPLY;
+    settle.window = object.value("window").toInt(1000);
+    settle.slope = object.value("slope").toDouble(0.0);
+    settle.deviation = object.value("deviation").toDouble(0.0);
+    if (settle.detect && !parseField(object.value("field").toString(), settle.field)) {
+        return false;
+    }
+    return true;
+}
+
+bool TestPlan::parseMeasurement(const QJsonObject &object, TestPlan::Measurement &measurement)
+{
+    if (!parseField(object.value("field").toString(), measurement.field)) {
+        return false;
+    }
+    measurement.name = object.value("name").toString(object.value("field").toString());
+    measurement.column = object.value("column").toString();
+
+    auto reduce = object.value("reduce").toString("mean");
+    if (reduce == "mean") {
+        measurement.reduce = Reduce::MEAN;
+    } else if (reduce == "last") {
+        measurement.reduce = Reduce::LAST;
+    } else {
+        return fail(QString("Measurement [%1] has unknown reduction [%2]").arg(measurement.name).arg(reduce));
+    }
+
+    QJsonValue limit;
+    if (object.contains("max")) {
+        measurement.bound = Bound::MAX;
+        limit = object.value("max");
+    } else if (object.contains("min")) {
+        measurement.bound = Bound::MIN;
+        limit = object.value("min");
+    } else {
+        measurement.bound = Bound::NONE;
+    }
+    measurement.limit = static_cast<float>(limit.toDouble(0.0));
+    measurement.limitKey = limit.toString();
+    return true;
+}
+
+bool TestPlan::parseRecord(const QJsonObject &object, TestPlan::Record &record)
+{
+    record.column = object.value("column").toString();
+    return parseField(object.value("field").toString(), record.field);
+}
+
+bool TestPlan::parseField(const QString &name, TestPlan::Field &field)
+{
+    static const std::vector<std::pair<QString, Field>> fields = {
+        {"iSupply",         Field::ISUPPLY},
+        {"iSupplyWing",     Field::ISUPPLY_WING},
+        {"slotLQI",         Field::SLOT_LQI},
+        {"slotLoss",        Field::SLOT_LOSS},
+        {"slotTemperature", Field::SLOT_TEMPERATURE},
+        {"wingSerial",      Field::WING_SERIAL},
+        {"wingLQI",         Field::WING_LQI},
+        {"wingLoss",        Field::WING_LOSS},
+        {"wingHumidity",    Field::WING_HUMIDITY},
+        {"wingTemperature", Field::WING_TEMPERATURE},
+        {"wingBatCapacity", Field::WING_BAT_CAPACITY},
+        {"wingBatVolt",     Field::WING_BAT_VOLT},
+        {"wingBatCurrent",  Field::WING_BAT_CURRENT},
+    };
+    for (const auto& entry: fields) {
+        if (entry.first == name) {
+            field = entry.second;
+            return true;
+        }
+    }
+    return fail(QString("Unknown field [%1]").arg(name));
+}
+
+bool TestPlan::fail(const QString &message)
+{
+    m_error = message;
+    return false;
+}
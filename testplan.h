@@ -0,0 +1,124 @@
+#ifndef TESTPLAN_H
+#define TESTPLAN_H
+
+#include <QString>
+#include <QJsonObject>
+#include <vector>
+#include "wingslot.h"
+
+class TestPlan
+{
+public:
+    enum class Field {
+        ISUPPLY,
+        ISUPPLY_WING,
+        SLOT_LQI,
+        SLOT_LOSS,
+        SLOT_TEMPERATURE,
+        WING_SERIAL,
+        WING_LQI,
+        WING_LOSS,
+        WING_HUMIDITY,
+        WING_TEMPERATURE,
+        WING_BAT_CAPACITY,
+        WING_BAT_VOLT,
+        WING_BAT_CURRENT,
+    };
+    enum class Reduce {
+        MEAN,
+        LAST,
+    };
+    enum class Bound {
+        NONE,
+        MAX,
+        MIN,
+    };
+    enum class Charge {
+        KEEP,
+        OFF,
+        ON,
+    };
+    enum class Completion {
+        DURATION,
+        PAIRED,
+    };
+
+    struct Measurement {
+        QString name;
+        Field field;
+        Reduce reduce;
+        Bound bound;
+        QString limitKey;                   // Named limit, resolved by the test engine
+        float limit;                        // Used when no named limit is given
+        QString column;
+    };
+    struct Record {
+        Field field;
+        QString column;
+    };
+    struct Settle {
+        int maxDelay;                       // [Milliseconds] Sampling starts no later than this
+        bool detect;                        // Start as soon as the field is stationary
+        Field field;
+        int window;                         // [Milliseconds]
+        double slope;                       // [Units per second]
+        double deviation;                   // [Units]
+    };
+    struct Phase {
+        QString name;
+        QString state;                      // Reported state, resolved by the test engine
+        Charge charge;
+        bool pair;
+        bool requireWing;
+        Completion completion;
+        QString durationKey;                // Named duration, resolved by the test engine
+        int duration;                       // [Milliseconds] Used when no named duration is given
+        Settle settle;
+        QString durationColumn;
+        QString elapsedColumn;
+        QString timeoutMessage;
+        std::vector<Measurement> measurements;
+        std::vector<Record> records;
+    };
+
+    TestPlan();
+    static const QString BUILTIN;
+
+    bool load(const QString &filename);
+    bool parse(const QByteArray &json);
+    const QString &errorString() const;
+
+    const QString &version() const;
+    const QString &title() const;
+    const QString &path() const;
+    void setPath(const QString &path);
+    const QString &product() const;
+    const QString &productFamily() const;
+    const std::vector<QString> &columns() const;
+    const std::vector<Phase> &phases() const;
+    const std::vector<Record> &records() const;
+
+    static double value(const WingSlot::Stats &stats, const Field field);
+    static bool isWingField(const Field field);
+
+protected:
+    bool parsePhase(const QJsonObject &object, Phase &phase);
+    bool parseSettle(const QJsonObject &object, Settle &settle);
+    bool parseMeasurement(const QJsonObject &object, Measurement &measurement);
+    bool parseRecord(const QJsonObject &object, Record &record);
+    bool parseField(const QString &name, Field &field);
+    bool fail(const QString &message);
+
+private:
+    QString m_error;
+    QString m_version;
+    QString m_title;
+    QString m_path;
+    QString m_product;
+    QString m_productFamily;
+    std::vector<QString> m_columns;
+    std::vector<Phase> m_phases;
+    std::vector<Record> m_records;
+};
+
+#endif // TESTPLAN_H
@@ -0,0 +1,202 @@
+#include "testscheduler.h"
+#include <QJsonArray>
+#include <algorithm>
+
+TestScheduler::TestScheduler(QObject *parent)
+    : QObject(parent)
+    , m_capacity({1, 1, 1})
+    , m_interval(1000)
+    , m_completed(0)
+{
+
+}
+
+TestScheduler::~TestScheduler()
+{
+    // Leave the journal behind, the batch resumes on the next start
+    halt();
+}
+
+void TestScheduler::setCapacity(const TestScheduler::Capacity &capacity)
+{
+    m_capacity = capacity;
+    admit();
+}
+
+TestScheduler::Capacity TestScheduler::capacity() const
+{
+    return m_capacity;
+}
+
+void TestScheduler::enqueue(WingSlot &unit)
+{
+    m_queue.push_back({&unit, QJsonObject()});
+}
+
+void TestScheduler::setJournal(const QString &filename)
+{
+    m_journal.setFile(filename);
+}
+
+int TestScheduler::resume(WingSlot::SlotList &units)
+{
+    QJsonObject journal;
+    if (isRunning() || !m_journal.read(journal)) {
+        return 0;
+    }
+    if (journal["plan"].toString() != EscFuncTest::plan().version()) {
+        m_journal.clear();
+        return 0;
+    }
+
+    int resumed = 0;
+    for (const auto& entry: journal["tests"].toArray()) {
+        auto checkpoint = entry.toObject();
+        auto unit = std::find_if(units.begin(), units.end(), [&](WingSlot::Unit &u){
+            return u.get().id() == checkpoint["unit"].toInt();
+        });
+        if (unit == units.end()) {
+            continue;
+        }
+        m_queue.push_back({&unit->get(), checkpoint});
+        ++resumed;
+    }
+    return resumed;
+}
+
+void TestScheduler::start(const int interval)
+{
+    m_interval = interval;
+    if (!isRunning()) {
+        m_completed = 0;
+        m_batchWatch.start();
+    }
+    admit();
+}
+
+void TestScheduler::stop()
+{
+    halt();
+    m_journal.clear();
+}
+
+bool TestScheduler::isRunning() const
+{
+    return !m_running.empty();
+}
+
+std::vector<WingSlot*> TestScheduler::units() const
+{
+    std::vector<WingSlot*> units;
+    for (const auto& slot: m_running) {
+        units.push_back(slot.unit);
+    }
+    return units;
+}
+
+bool TestScheduler::exchange(const EscFuncTest::Resources &held, const EscFuncTest::Resources &wanted)
+{
+    auto radio = m_inUse.radio - held.radio + wanted.radio;
+    auto power = m_inUse.power - held.power + wanted.power;
+    if ((wanted.radio > held.radio && radio > m_capacity.radio) ||
+        (wanted.power > held.power && power > m_capacity.power)) {
+        return false;
+    }
+    m_inUse.radio = radio;
+    m_inUse.power = power;
+    return true;
+}
+
+void TestScheduler::admit()
+{
+    while (!m_queue.empty() && static_cast<int>(m_running.size()) < m_capacity.units) {
+        auto unit = m_queue.front().unit;
+        auto resumed = m_queue.front().checkpoint;
+        m_queue.pop_front();
+
+        auto test = new EscFuncTest(*unit, this);
+        test->setGate(this);
+        if (!resumed.isEmpty() && !test->restore(resumed)) {
+            emit error(QString("[#%0] could not resume from the journal, restarting").arg(unit->id()));
+        }
+        connect(test, &EscFuncTest::progressed, this, &TestScheduler::checkpoint);
+        connect(test, &EscFuncTest::finished, this,
+                [=](const EscFuncTest::State &state, const bool &passed, const QString &message){
+            emit finished(unit, state, passed, message);
+            if (state == EscFuncTest::State::DONE) {
+                retire(test);
+            }
+        });
+        connect(test, &EscFuncTest::error, this,
+                [=](const QString &message){
+            emit error(message);
+            retire(test);
+        });
+
+        m_running.push_back({unit, test});
+        test->start(m_interval);
+        emit admitted(unit);
+    }
+    checkpoint();
+}
+
+void TestScheduler::retire(EscFuncTest *test)
+{
+    auto slot = std::find_if(m_running.begin(), m_running.end(), [&](const Slot &s){
+        return s.test == test;
+    });
+    if (slot == m_running.end()) {
+        return;
+    }
+    m_running.erase(slot);
+    test->deleteLater();
+    ++m_completed;
+
+    admit();
+    if (m_running.empty()) {
+        emit completed(m_completed, m_batchWatch.elapsed());
+    }
+}
+
+void TestScheduler::halt()
+{
+    for (auto& slot: m_running) {
+        slot.test->stop();
+        slot.test->deleteLater();
+    }
+    m_running.clear();
+    m_queue.clear();
+    m_inUse = EscFuncTest::Resources();
+}
+
+void TestScheduler::checkpoint()
+{
+    if (!m_journal.isEnabled()) {
+        return;
+    }
+    if (m_running.empty() && m_queue.empty()) {
+        m_journal.clear();
+        return;
+    }
+
+    QJsonArray tests;
+    for (const auto& slot: m_running) {
+        tests.append(slot.test->checkpoint());
+    }
+    for (const auto& pending: m_queue) {
+        if (pending.checkpoint.isEmpty()) {
+            QJsonObject queued;
+            queued["unit"] = pending.unit->id();
+            tests.append(queued);
+        } else {
+            tests.append(pending.checkpoint);
+        }
+    }
+
+    QJsonObject journal;
+    journal["plan"] = EscFuncTest::plan().version();
+    journal["tests"] = tests;
+    if (!m_journal.write(journal)) {
+        emit error(QString("Could not write the test journal"));
+    }
+}
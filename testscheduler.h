@@ -0,0 +1,67 @@
+#ifndef TESTSCHEDULER_H
+#define TESTSCHEDULER_H
+
+#include <QObject>
+#include <QJsonObject>
+#include <deque>
+#include <vector>
+#include "wingslot.h"
+#include "escfunctest.h"
+#include "escclock.h"
+#include "testjournal.h"
+
+class TestScheduler : public QObject, public EscFuncTest::Gate
+{
+    Q_OBJECT
+public:
+    struct Capacity {
+        int units;                          // Tests in flight
+        int radio;                          // Units pairing at once
+        int power;                          // Units charging at once
+    };
+
+    explicit TestScheduler(QObject *parent = nullptr);
+    ~TestScheduler();
+    void setCapacity(const Capacity &capacity);
+    Capacity capacity() const;
+    void enqueue(WingSlot &unit);
+    void setJournal(const QString &filename);
+    int resume(WingSlot::SlotList &units);
+    void start(const int interval);
+    void stop();
+    bool isRunning() const;
+    std::vector<WingSlot*> units() const;
+    bool exchange(const EscFuncTest::Resources &held, const EscFuncTest::Resources &wanted) override;
+
+signals:
+    void admitted(WingSlot *unit);
+    void finished(WingSlot *unit, const EscFuncTest::State &state, const bool &passed, const QString &message);
+    void error(const QString &message);
+    void completed(const int units, const int elapsed);
+
+protected:
+    void admit();
+    void retire(EscFuncTest *test);
+    void halt();
+    void checkpoint();
+
+private:
+    struct Slot {
+        WingSlot *unit;
+        EscFuncTest *test;
+    };
+    struct Pending {
+        WingSlot *unit;
+        QJsonObject checkpoint;             // Empty unless resumed from the journal
+    };
+    std::deque<Pending> m_queue;
+    std::vector<Slot> m_running;
+    Capacity m_capacity;
+    EscFuncTest::Resources m_inUse;
+    int m_interval;
+    int m_completed;
+    EscStopwatch m_batchWatch;
+    TestJournal m_journal;
+};
+
+#endif // TESTSCHEDULER_H
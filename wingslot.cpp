@@ -11,10 +11,12 @@ std::vector<std::unique_ptr<WingSlot>> WingSlot::s_slots;
 WingSlot::WingSlot(int id, int bus)
     : m_id(id)
     , m_bus(bus)
+    , m_ticker(EscClock::instance().createTicker(this))
     , m_pairing(false)
     , m_charging(false)
+    , m_data()
 {
-    QObject::connect(&m_ticker, &QTimer::timeout, this,
+    QObject::connect(m_ticker, &EscTicker::timeout, this,
             [=](){
         m_freezeWatch.restart();
         SmartCageData1 data;
@@ -263,18 +265,18 @@ void WingSlot::pair()
 bool WingSlot::setSampling(int interval)
 {
     if (interval <= 0) {
-        m_ticker.stop();
+        m_ticker->stop();
         return true;
     }
-    if (m_ticker.interval() != interval || !m_ticker.isActive()) {
+    if (m_ticker->interval() != interval || !m_ticker->isActive()) {
         if (!setWingSampling(WING_COM_INTERVAL)) { // setWingSampling(static_cast<double>(interval/(1000.0 * WINGDATA_PER_SAMPLE)))
             qDebug() << QString("[#%1] did not set wing samp").arg(m_id);
         }
 
-        if (m_ticker.isActive()) {
-            m_ticker.setInterval(interval);
+        if (m_ticker->isActive()) {
+            m_ticker->setInterval(interval);
         } else {
-            m_ticker.start(interval);
+            m_ticker->start(interval);
         }
         m_inactivityWatch.start();
         m_freezeWatch.start();
@@ -284,7 +286,7 @@ bool WingSlot::setSampling(int interval)
 
 int WingSlot::sampling() const
 {
-    return (m_ticker.isActive()) ? m_ticker.interval() : 0;
+    return (m_ticker->isActive()) ? m_ticker->interval() : 0;
 }
 
 void WingSlot::setFirmware(const QString &firmware)
@@ -2,8 +2,7 @@
 #define WINGSLOT_H
 
 #include <QObject>
-#include <QTimer>
-#include <QTime>
+#include "escclock.h"
 #include "ebird.hh"
 #include "smartcageif.h"
 #include <vector>
@@ -51,7 +50,7 @@ public:
     bool isPaired() const;
     void pair();
     bool setAutoPair(bool enable);
-    bool setCharge(bool enable);
+    virtual bool setCharge(bool enable);
     bool isCharging() const;
     bool setSampling(int interval);
     int sampling() const;
@@ -72,21 +71,21 @@ protected:
     int inactivityDuration() const;
     void registerActivity(const bool presence);
     void setFirmware(const QString &firmware);
-    bool getData(SmartCageData1 &data);
-    bool setWingSampling(float interval);
-    bool startPairing();
+    virtual bool getData(SmartCageData1 &data);
+    virtual bool setWingSampling(float interval);
+    virtual bool startPairing();
     bool processResponse(bool ok);
 
 private:
     int m_id;
     int m_bus;
-    QTimer m_ticker;
-    QTime m_pairingWatch;
+    EscTicker *m_ticker;
+    EscStopwatch m_pairingWatch;
     bool m_pairing;
     bool m_charging;
     Stats m_data;
-    QTime m_inactivityWatch;
-    QTime m_freezeWatch;
+    EscStopwatch m_inactivityWatch;
+    EscStopwatch m_freezeWatch;
 
     static double s_loadFactor;
     static eBird::Birdcom_var s_esvr;